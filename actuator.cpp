@@ -0,0 +1,87 @@
+/**
+ * @file actuator.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains functionality for driving a lock actuator
+ * through its drive profile.
+ * @bug No known bugs.
+ */
+#include "actuator.hpp"
+#include "pinmap.h"
+
+using namespace std::chrono;
+
+static queue_site_t actuator_site = QUEUE_SITE("actuator");
+
+Actuator::Actuator(ProfiledEventQueue *event_queue, PinName pin,
+                   const drive_profile_t *profile)
+    : _event_queue(event_queue), _profile(profile), _dac(NULL), _pwm(NULL),
+      _step_event(0), _driven_us(0) {
+#if DEVICE_ANALOGOUT
+  if (pinmap_find_peripheral(pin, analogout_pinmap()) != (uint32_t)NC) {
+    _dac = new AnalogOut(pin);
+  }
+#endif
+  if (!_dac) {
+    _pwm = new PwmOut(pin);
+    _pwm->period_us(_profile->pwm_period_us);
+  }
+  _write(0.0f);
+}
+
+Actuator::~Actuator() {
+  release();
+  delete _dac;
+  delete _pwm;
+}
+
+void Actuator::energize() {
+  if (_step_event) {
+    _event_queue->cancel(_step_event);
+    _step_event = 0;
+  }
+  _timer.reset();
+  _timer.start();
+  _step();
+}
+
+void Actuator::release() {
+  if (_step_event) {
+    _event_queue->cancel(_step_event);
+    _step_event = 0;
+  }
+  _timer.stop();
+  _write(0.0f);
+}
+
+uint64_t Actuator::driven_at() { return _driven_us; }
+
+void Actuator::on_release(mbed::Callback<void()> on_release) {
+  _on_release = on_release;
+}
+
+void Actuator::_step() {
+  _step_event = 0;
+  uint32_t elapsed = duration_cast<milliseconds>(_timer.elapsed_time()).count();
+  _write(drive_level_at(_profile, elapsed));
+  _driven_us = ticker_read_us(get_us_ticker_data());
+
+  int32_t next = drive_next_change(_profile, elapsed);
+  if (next >= 0) {
+    _step_event = _event_queue->call_in(
+        &actuator_site, milliseconds(next - elapsed), this, &Actuator::_step);
+  } else if (_profile->release_ms && elapsed >= _profile->release_ms &&
+             _on_release) {
+    _on_release();
+  }
+}
+
+void Actuator::_write(float level) {
+  if (_dac) {
+    _dac->write(level);
+  } else {
+    _pwm->write(level);
+  }
+}
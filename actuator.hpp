@@ -0,0 +1,90 @@
+/**
+ * @file actuator.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines the class for driving a lock actuator through
+ * its drive profile.
+ * @bug No known bugs.
+ */
+#ifndef ACTUATOR_H
+#define ACTUATOR_H
+
+#include "drive_profile.hpp"
+#include "mbed.h"
+#include "profiled_event_queue.hpp"
+
+class Actuator : private mbed::NonCopyable<Actuator> {
+public:
+  /**
+   * @brief Construct a new Actuator object. Pins with a DAC are driven
+   * through the DAC, other pins through PWM.
+   *
+   * @param event_queue The queue that runs the profile steps.
+   * @param pin The pin wired to the actuator.
+   * @param profile The drive profile of the actuator.
+   * @return Instance of Actuator.
+   */
+  Actuator(ProfiledEventQueue *event_queue, PinName pin,
+           const drive_profile_t *profile);
+
+  ~Actuator();
+
+  /**
+   * @brief Start driving the actuator through its profile.
+   *
+   * @return Void.
+   */
+  void energize();
+
+  /**
+   * @brief Stop driving the actuator.
+   *
+   * @return Void.
+   */
+  void release();
+
+  /**
+   * @brief Returns when the output level last changed.
+   *
+   * @return The time in microseconds of the us ticker.
+   */
+  uint64_t driven_at();
+
+  /**
+   * @brief Sets what runs when the profile releases the output on its own,
+   * before release() is called.
+   *
+   * @param on_release The callback.
+   * @return Void.
+   */
+  void on_release(mbed::Callback<void()> on_release);
+
+private:
+  ProfiledEventQueue *_event_queue;
+  const drive_profile_t *_profile;
+  AnalogOut *_dac;
+  PwmOut *_pwm;
+  Timer _timer;
+  int _step_event;
+  uint64_t _driven_us;
+  mbed::Callback<void()> _on_release;
+
+  /**
+   * @brief Apply the profile level for the time since the actuator was
+   * energized and schedule the next change.
+   *
+   * @return Void.
+   */
+  void _step();
+
+  /**
+   * @brief Set the output level.
+   *
+   * @return Void.
+   */
+  void _write(float level);
+};
+
+#endif // ACTUATOR_H
@@ -9,6 +9,16 @@
  */
 #include "ble_service.hpp"
 
+// Time from the BLE stack signalling a code to its lock being driven open
+static latency_histogram_t unlock_latency;
+// When the stack first signalled the events being processed, and the events
+// still waiting, in microseconds of the us ticker
+static uint64_t ble_events_signalled_us = 0;
+static volatile uint64_t ble_events_pending_us = 0;
+
+static queue_site_t ble_events_site = QUEUE_SITE("ble events");
+static queue_site_t advertising_site = QUEUE_SITE("advertising");
+
 /**
  * @brief Print BLE error.
  *
@@ -85,12 +95,13 @@ inline void print_ble_error(ble_error_t error, const char *msg) {
  * @copyright Copyright (c) ARM Limited. (Apache-2.0 License)
  */
 class SmartLockBLEProcess : private mbed::NonCopyable<SmartLockBLEProcess>,
-                            public ble::Gap::EventHandler {
+                            public ble::Gap::EventHandler,
+                            public ble::SecurityManager::EventHandler {
 public:
   /**
    * @brief Construct a BLEProcess from an event queue and a ble interface.
    */
-  SmartLockBLEProcess(events::EventQueue &event_queue, BLE &ble_interface)
+  SmartLockBLEProcess(ProfiledEventQueue &event_queue, BLE &ble_interface)
       : _event_queue(event_queue), _ble(ble_interface),
         _gap(ble_interface.gap()), _adv_data_builder(_adv_buffer) {}
 
@@ -139,6 +150,32 @@ public:
     _post_init_cb = cb;
   }
 
+  /**
+   * @brief Subscription to the connection event.
+   *
+   * @param[in] cb The callback object that will be called with the address of
+   * a device when it connects.
+   */
+  void on_connect(mbed::Callback<void(const char *)> cb) { _connect_cb = cb; }
+
+  /**
+   * @brief Subscription to the disconnection event.
+   *
+   * @param[in] cb The callback object that will be called when a device
+   * disconnects.
+   */
+  void on_disconnect(mbed::Callback<void()> cb) { _disconnect_cb = cb; }
+
+  /**
+   * @brief Subscription to the identity of bonded devices.
+   *
+   * @param[in] cb The callback object that will be called with the identity
+   * address of a bonded device once its link is authenticated.
+   */
+  void on_identity(mbed::Callback<void(const char *)> cb) {
+    _identity_cb = cb;
+  }
+
 protected:
   /**
    * @brief Sets up adverting payload and start advertising.
@@ -163,6 +200,7 @@ protected:
       }
     }
 
+    start_security();
     start_activity();
 
     if (_post_init_cb) {
@@ -170,6 +208,84 @@ protected:
     }
   }
 
+  /**
+   * @brief Enables pairing with bonding. The lock shows a passkey on the
+   * console that the client must enter, so pairing needs access to the lock
+   * and links are authenticated. Bonds are kept on the file system.
+   *
+   * @return Void.
+   */
+  void start_security() {
+    ble::SecurityManager &security = _ble.securityManager();
+    ble_error_t error =
+        security.init(true, true, SecurityManager::IO_CAPS_DISPLAY_ONLY, NULL,
+                      false, BLE_SECURITY_DB_PATH);
+    if (error) {
+      print_ble_error(error, "SecurityManager::init() failed\r\n");
+      return;
+    }
+    security.preserveBondingStateOnReset(true);
+    security.setSecurityManagerEventHandler(this);
+  }
+
+  /**
+   * @brief Shows the passkey the client must enter to pair.
+   */
+  void passkeyDisplay(ble::connection_handle_t connectionHandle,
+                      const SecurityManager::Passkey_t passkey) override {
+    printf("> Pairing passkey: %.6s\n", (const char *)passkey);
+  }
+
+  /**
+   * @brief Reports the outcome of pairing.
+   */
+  void pairingResult(ble::connection_handle_t connectionHandle,
+                     SecurityManager::SecurityCompletionStatus_t result)
+      override {
+    printf("> Pairing %s\n",
+           result == SecurityManager::SEC_STATUS_SUCCESS ? "succeeded"
+                                                         : "failed");
+  }
+
+  /**
+   * @brief Asks for the identity of a bonded device once its link is
+   * encrypted with authenticated keys.
+   */
+  void linkEncryptionResult(ble::connection_handle_t connectionHandle,
+                            ble::link_encryption_t result) override {
+    if (result == ble::link_encryption_t::ENCRYPTED_WITH_MITM ||
+        result == ble::link_encryption_t::ENCRYPTED_WITH_SC_AND_MITM) {
+      _ble.securityManager().getPeerIdentity(connectionHandle);
+    }
+  }
+
+  /**
+   * @brief Passes on the identity address of a bonded device. Unlike the
+   * connection address, it is fixed for the device and cannot be used
+   * without its keys, so it is what lock users are matched against.
+   */
+  void peerIdentity(ble::connection_handle_t connectionHandle,
+                    const ble::address_t *peer_address,
+                    bool address_is_public) override {
+    if (!peer_address) {
+      return;
+    }
+    const ble::address_t &addr = *peer_address;
+    char identity[DEVICE_ADDRESS_LENGTH + 1];
+    sprintf(identity, "%02x:%02x:%02x:%02x:%02x:%02x", addr[5], addr[4],
+            addr[3], addr[2], addr[1], addr[0]);
+    printf("> Device %s has identity %s (%s)\n", _peer_address, identity,
+           address_is_public ? "public" : "random static");
+
+    char log_message[60];
+    sprintf(log_message, "Device %s identified as %s", _peer_address,
+            identity);
+    write_log(log_message);
+    if (_identity_cb) {
+      _identity_cb(identity);
+    }
+  }
+
   /**
    * @brief Start the gatt client process when a connection event is received.
    * This is called by Gap to notify the application we connected
@@ -181,11 +297,15 @@ protected:
       printf("> Connected to %02x:%02x:%02x:%02x:%02x:%02x using BLE\n",
              addr[5], addr[4], addr[3], addr[2], addr[1], addr[0]);
 
+      sprintf(_peer_address, "%02x:%02x:%02x:%02x:%02x:%02x", addr[5],
+              addr[4], addr[3], addr[2], addr[1], addr[0]);
+
       char log_message[50];
-      sprintf(log_message,
-              "Device %02x:%02x:%02x:%02x:%02x:%02x connected using BLE",
-              addr[5], addr[4], addr[3], addr[2], addr[1], addr[0]);
+      sprintf(log_message, "Device %s connected using BLE", _peer_address);
       write_log(log_message);
+      if (_connect_cb) {
+        _connect_cb(_peer_address);
+      }
     } else {
       printf("Failed to connect\r\n");
       start_activity();
@@ -200,10 +320,26 @@ protected:
   void onDisconnectionComplete(
       const ble::DisconnectionCompleteEvent &event) override {
     printf("> Device disconnected using BLE\n");
-    write_log("Device disconnected using BLE");
+    char log_message[50];
+    sprintf(log_message, "Device %s disconnected using BLE", _peer_address);
+    write_log(log_message);
+    if (_disconnect_cb) {
+      _disconnect_cb();
+    }
     start_activity();
   }
 
+  /**
+   * @brief Reports the link layer payload size once Data Length Extension has
+   * been negotiated.
+   */
+  void onDataLengthChange(ble::connection_handle_t connectionHandle,
+                          uint16_t txNumberOfBytes,
+                          uint16_t rxNumberOfBytes) override {
+    printf("> Data length set to %u bytes TX, %u bytes RX\n", txNumberOfBytes,
+           rxNumberOfBytes);
+  }
+
   /**
    * @brief Restarts main activity
    */
@@ -215,7 +351,7 @@ protected:
    * @brief Start advertising or scanning. Triggered by init or disconnection.
    */
   virtual void start_activity() {
-    _event_queue.call([this]() { start_advertising(); });
+    _event_queue.call(&advertising_site, [this]() { start_advertising(); });
   }
 
   /**
@@ -257,6 +393,7 @@ protected:
     }
 
     printf("> Advertising as \"%s\"\r\n", DEVICE_NAME);
+    boot_phase_end(BOOT_PHASE_ADVERTISING);
   }
 
   /**
@@ -264,11 +401,30 @@ protected:
    * queue.
    */
   void schedule_ble_events(BLE::OnEventsToProcessCallbackContext *event) {
-    _event_queue.call(mbed::callback(&event->ble, &BLE::processEvents));
+    if (!ble_events_pending_us) {
+      ble_events_pending_us = ticker_read_us(get_us_ticker_data());
+    }
+    _event_queue.call(&ble_events_site, this,
+                      &SmartLockBLEProcess::process_ble_events);
+  }
+
+  /**
+   * @brief Processes events from the BLE middleware, noting when the stack
+   * signalled them so handlers can time from their arrival.
+   *
+   * @return Void.
+   */
+  void process_ble_events() {
+    {
+      CriticalSectionLock lock;
+      ble_events_signalled_us = ble_events_pending_us;
+      ble_events_pending_us = 0;
+    }
+    _ble.processEvents();
   }
 
 protected:
-  events::EventQueue &_event_queue;
+  ProfiledEventQueue &_event_queue;
   BLE &_ble;
   ble::Gap &_gap;
 
@@ -278,6 +434,11 @@ protected:
   ble::advertising_handle_t _adv_handle = ble::LEGACY_ADVERTISING_HANDLE;
 
   mbed::Callback<void(BLE &, events::EventQueue &)> _post_init_cb;
+  mbed::Callback<void(const char *)> _connect_cb;
+  mbed::Callback<void()> _disconnect_cb;
+  mbed::Callback<void(const char *)> _identity_cb;
+
+  char _peer_address[DEVICE_ADDRESS_LENGTH + 1] = "";
 };
 
 /**
@@ -294,6 +455,542 @@ int digits_only(const char *s) {
   return 1;
 }
 
+/**
+ * @brief Reads a code sent as 6 characters or as 3 bytes, which are written
+ * as hex.
+ *
+ * @param data The code.
+ * @param length The length of the code, 3 or 6.
+ * @param code The 7 byte buffer the code is written to.
+ * @return Void.
+ */
+void read_code(const uint8_t *data, uint16_t length, char *code) {
+  if (length == 6) {
+    memcpy(code, data, 6);
+    code[6] = '\0';
+  } else {
+    bytes_to_hex(data, 3, code, 7);
+  }
+}
+
+/**
+ * @brief Reads a little endian 32-bit value.
+ *
+ * @return The value.
+ */
+uint32_t read_le32(const uint8_t *data) {
+  return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+/**
+ * @brief Writes a little endian 16-bit value.
+ *
+ * @return The address after the value.
+ */
+uint8_t *write_le16(uint8_t *data, uint16_t value) {
+  data[0] = value;
+  data[1] = value >> 8;
+  return data + 2;
+}
+
+/**
+ * @brief Writes a little endian 32-bit value.
+ *
+ * @return The address after the value.
+ */
+uint8_t *write_le32(uint8_t *data, uint32_t value) {
+  data = write_le16(data, value);
+  return write_le16(data, value >> 16);
+}
+
+/**
+ * @brief Writes a histogram as its sample count, mean and maximum followed by
+ * its bucket counts, each saturated to 16 bits.
+ *
+ * @return The address after the histogram.
+ */
+uint8_t *write_histogram(uint8_t *data, const latency_histogram_t *histogram) {
+  uint32_t mean =
+      histogram->samples ? histogram->total_us / histogram->samples : 0;
+  data = write_le32(data, histogram->samples);
+  data = write_le32(data, mean);
+  data = write_le32(data, histogram->max_us);
+  for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+    uint32_t count = histogram->counts[bucket];
+    data = write_le16(data, count > UINT16_MAX ? UINT16_MAX : count);
+  }
+  return data;
+}
+
+static queue_site_t export_retry_site = QUEUE_SITE("export retry");
+
+/**
+ * @brief Retries a notification the stack refused while none of the
+ * exporter's notifications were in flight.
+ */
+class ExportRetry : private mbed::NonCopyable<ExportRetry> {
+public:
+  /**
+   * @brief Construct a new ExportRetry object.
+   *
+   * @param event_queue The queue that runs the retries.
+   * @return Instance of ExportRetry.
+   */
+  ExportRetry(ProfiledEventQueue *event_queue) : _event_queue(event_queue) {}
+
+  /**
+   * @brief Runs a method after EXPORT_RETRY_DELAY, unless a retry is already
+   * pending.
+   *
+   * @param obj The exporter.
+   * @param method The method that sends again.
+   * @return False once EXPORT_MAX_RETRIES retries in a row were refused and
+   * the export should be abandoned.
+   */
+  template <typename T> bool schedule(T *obj, void (T::*method)()) {
+    if (_event) {
+      return true;
+    }
+    if (++_count > EXPORT_MAX_RETRIES) {
+      return false;
+    }
+    _event = _event_queue->call_in(&export_retry_site, EXPORT_RETRY_DELAY,
+                                   obj, method);
+    return _event != 0;
+  }
+
+  /**
+   * @brief Marks the pending retry as run. Call first thing in the method.
+   *
+   * @return Void.
+   */
+  void fired() { _event = 0; }
+
+  /**
+   * @brief Resets the count after a notification was accepted.
+   *
+   * @return Void.
+   */
+  void succeeded() { _count = 0; }
+
+  /**
+   * @brief Cancels the pending retry and resets the count.
+   *
+   * @return Void.
+   */
+  void cancel() {
+    if (_event) {
+      _event_queue->cancel(_event);
+      _event = 0;
+    }
+    _count = 0;
+  }
+
+private:
+  ProfiledEventQueue *_event_queue;
+  int _event = 0;
+  int _count = 0;
+};
+
+/**
+ * @brief Sends the event queue statistics to a subscribed client, one record
+ * per call site followed by an empty notification.
+ *
+ * Each record holds the name of the site padded to QUEUE_SITE_NAME_LENGTH
+ * bytes, its peak queue depth and its wait and run histograms, all little
+ * endian. Records are QUEUE_STATS_RECORD_LENGTH bytes long and are split
+ * across as many notifications as the negotiated ATT MTU requires, so the
+ * client rebuilds them by concatenating the notifications.
+ */
+class QueueStatsExporter : private mbed::NonCopyable<QueueStatsExporter> {
+public:
+  /**
+   * @brief Construct a new QueueStatsExporter object.
+   *
+   * @param uuid The UUID of the characteristic that carries the statistics.
+   * @param event_queue The queue whose statistics are sent.
+   * @return Instance of QueueStatsExporter.
+   */
+  QueueStatsExporter(uint16_t uuid, ProfiledEventQueue *event_queue)
+      : _characteristic(uuid, _record, 0, sizeof(_record),
+                        GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY,
+                        NULL, 0, true),
+        _event_queue(event_queue), _retry(event_queue) {}
+
+  /**
+   * @brief Returns the characteristic that carries the statistics.
+   *
+   * @return The queue statistics characteristic.
+   */
+  GattCharacteristic *characteristic() { return &_characteristic; }
+
+  /**
+   * @brief Sets the payload size used by subsequent notifications.
+   *
+   * @param att_mtu The negotiated ATT MTU.
+   * @return Void.
+   */
+  void set_mtu(uint16_t att_mtu) {
+    _chunk_size = att_mtu - 3 < QUEUE_STATS_RECORD_LENGTH
+                      ? att_mtu - 3
+                      : QUEUE_STATS_RECORD_LENGTH;
+  }
+
+  /**
+   * @brief Resets the payload size to the default ATT MTU.
+   *
+   * @return Void.
+   */
+  void reset_mtu() { _chunk_size = 20; }
+
+  /**
+   * @brief Starts sending the statistics from the first call site.
+   *
+   * @param server The GATT server used to send notifications.
+   * @return Void.
+   */
+  void start(ble::GattServer &server) {
+    _retry.cancel();
+    _server = &server;
+    _index = 0;
+    _offset = 0;
+    _in_flight = false;
+    send();
+  }
+
+  /**
+   * @brief Stops sending, e.g. when the client unsubscribes.
+   *
+   * @return Void.
+   */
+  void stop() {
+    _retry.cancel();
+    _server = NULL;
+  }
+
+  /**
+   * @brief Called when the stack has sent any notification, since a failed
+   * send waits for stack buffers to be freed.
+   *
+   * @param own Whether the notification was sent by this exporter.
+   * @return Void.
+   */
+  void on_sent(bool own) {
+    if (own) {
+      _in_flight = false;
+    }
+    if (!_in_flight) {
+      send();
+    }
+  }
+
+private:
+  GattCharacteristic _characteristic;
+  uint8_t _record[QUEUE_STATS_RECORD_LENGTH];
+  ProfiledEventQueue *_event_queue;
+  ExportRetry _retry;
+  ble::GattServer *_server = NULL;
+  uint16_t _chunk_size = 20;
+  int _index = 0;
+  // The bytes of the current record already sent
+  int _offset = 0;
+  bool _in_flight = false;
+
+  /**
+   * @brief Sends again after a refused notification.
+   *
+   * @return Void.
+   */
+  void retry() {
+    _retry.fired();
+    send();
+  }
+
+  /**
+   * @brief Sends the next part of the current call site, or the empty end
+   * notification.
+   *
+   * @return Void.
+   */
+  void send() {
+    if (!_server) {
+      return;
+    }
+
+    const queue_site_t *site = _event_queue->site(_index);
+    uint16_t length = 0;
+    if (site) {
+      if (_offset == 0) {
+        // The record is built once so its parts describe the same moment
+        memset(_record, 0, QUEUE_SITE_NAME_LENGTH);
+        strncpy((char *)_record, site->name, QUEUE_SITE_NAME_LENGTH);
+        uint8_t *data = write_le16(_record + QUEUE_SITE_NAME_LENGTH,
+                                   site->peak_depth);
+        data = write_histogram(data, &site->wait);
+        write_histogram(data, &site->run);
+      }
+      int remaining = QUEUE_STATS_RECORD_LENGTH - _offset;
+      length = remaining < _chunk_size ? remaining : _chunk_size;
+    }
+
+    ble_error_t error = _server->write(_characteristic.getValueHandle(),
+                                      _record + _offset, length);
+    if (error) {
+      // Stack buffers are full, retry once a notification has been sent,
+      // or after a delay if none of ours will be
+      if (!_in_flight && !_retry.schedule(this, &QueueStatsExporter::retry)) {
+        printf("> Queue statistics export abandoned\n");
+        stop();
+      }
+      return;
+    }
+    _retry.succeeded();
+    _in_flight = true;
+    if (!site) {
+      _server = NULL;
+      return;
+    }
+    _offset += length;
+    if (_offset == QUEUE_STATS_RECORD_LENGTH) {
+      _offset = 0;
+      _index++;
+    }
+  }
+};
+
+/**
+ * @brief Streams the device log to a subscribed client as notifications.
+ *
+ * Records are packed into chunks sized to the negotiated ATT MTU. Up to
+ * LOG_EXPORT_WINDOW notifications are queued with the stack at once and the
+ * next chunk is sent as each one completes. An empty notification marks the
+ * end of the log. When a filter is given, only matching records are sent.
+ */
+class LogExporter : private mbed::NonCopyable<LogExporter> {
+public:
+  /**
+   * @brief Construct a new LogExporter object.
+   *
+   * @param uuid The UUID of the characteristic that carries the log.
+   * @param properties The properties of the characteristic, which must
+   * include notify.
+   * @param event_queue The queue that retries refused notifications.
+   * @return Instance of LogExporter.
+   */
+  LogExporter(uint16_t uuid, uint8_t properties,
+              ProfiledEventQueue *event_queue)
+      : _characteristic(uuid, _value, 0, sizeof(_value), properties, NULL, 0,
+                        true),
+        _retry(event_queue) {}
+
+  /**
+   * @brief Returns the characteristic that carries the log.
+   *
+   * @return The log export characteristic.
+   */
+  GattCharacteristic *characteristic() { return &_characteristic; }
+
+  /**
+   * @brief Sets the payload size used by subsequent chunks.
+   *
+   * @param att_mtu The negotiated ATT MTU.
+   * @return Void.
+   */
+  void set_mtu(uint16_t att_mtu) {
+    _chunk_size = att_mtu - 3 < LOG_EXPORT_MAX_CHUNK ? att_mtu - 3
+                                                     : LOG_EXPORT_MAX_CHUNK;
+  }
+
+  /**
+   * @brief Starts streaming the log from the beginning.
+   *
+   * @param server The GATT server used to send notifications.
+   * @param filter The filter records must match, NULL to send every record.
+   * @return Void.
+   */
+  void start(ble::GattServer &server, const log_filter_t *filter = NULL) {
+    stop();
+    _file = open_logs();
+    if (!_file) {
+      return;
+    }
+    _server = &server;
+    _filtered = filter != NULL;
+    if (filter) {
+      _filter = *filter;
+    }
+    _matching = true;
+    _continuation = false;
+    _in_flight = 0;
+    _sent_bytes = 0;
+    _chunk_length = 0;
+    _record_length = 0;
+    _record_offset = 0;
+    _timer.reset();
+    _timer.start();
+    printf("> Exporting logs in %u byte chunks\n", _chunk_size);
+    send();
+  }
+
+  /**
+   * @brief Stops streaming, e.g. when the client unsubscribes.
+   *
+   * @return Void.
+   */
+  void stop() {
+    _retry.cancel();
+    if (_file) {
+      fclose(_file);
+      _file = NULL;
+    }
+    _server = NULL;
+  }
+
+  /**
+   * @brief Called when the stack has sent a notification.
+   *
+   * @return Void.
+   */
+  void on_sent() {
+    if (_in_flight > 0) {
+      _in_flight--;
+    }
+    send();
+  }
+
+  /**
+   * @brief Resets the payload size to the default ATT MTU.
+   *
+   * @return Void.
+   */
+  void reset_mtu() { _chunk_size = 20; }
+
+private:
+  GattCharacteristic _characteristic;
+  uint8_t _value[LOG_EXPORT_MAX_CHUNK];
+  ExportRetry _retry;
+  ble::GattServer *_server = NULL;
+  FILE *_file = NULL;
+  uint16_t _chunk_size = 20;
+  int _in_flight = 0;
+  size_t _sent_bytes = 0;
+  Timer _timer;
+
+  uint8_t _chunk[LOG_EXPORT_MAX_CHUNK];
+  uint16_t _chunk_length = 0;
+  char _record[LOG_EXPORT_MAX_CHUNK + 1];
+  int _record_length = 0;
+  int _record_offset = 0;
+
+  bool _filtered = false;
+  log_filter_t _filter;
+  bool _matching = true;
+  bool _continuation = false;
+
+  /**
+   * @brief Sends again after a refused notification.
+   *
+   * @return Void.
+   */
+  void retry() {
+    _retry.fired();
+    send();
+  }
+
+  /**
+   * @brief Reads the next record that passes the filter. Parts of a record
+   * too long for the buffer share the decision made on its first part.
+   *
+   * @return The length of the record, 0 at the end of the log.
+   */
+  int next_record() {
+    int length;
+    while ((length = read_log_record(_file, _record, sizeof(_record))) > 0) {
+      bool first_part = !_continuation;
+      if (first_part) {
+        _matching = !_filtered || log_record_matches(_record, &_filter);
+      }
+      _continuation = _record[length - 1] != '\n';
+      if (_matching) {
+        return first_part ? redact_log_record(_record) : length;
+      }
+    }
+    return 0;
+  }
+
+  /**
+   * @brief Packs the next chunk with whole records where they fit. Records
+   * longer than a chunk are split across chunks.
+   *
+   * @return The length of the chunk, 0 at the end of the log.
+   */
+  uint16_t fill_chunk() {
+    uint16_t length = 0;
+    while (length < _chunk_size) {
+      if (_record_offset == _record_length) {
+        _record_length = next_record();
+        _record_offset = 0;
+        if (_record_length == 0) {
+          break;
+        }
+      }
+      int remaining = _record_length - _record_offset;
+      int room = _chunk_size - length;
+      if (remaining > room && length > 0 && _record_offset == 0) {
+        break;
+      }
+      int count = remaining < room ? remaining : room;
+      memcpy(_chunk + length, _record + _record_offset, count);
+      length += count;
+      _record_offset += count;
+    }
+    return length;
+  }
+
+  /**
+   * @brief Sends chunks until the window is full or the log has been sent.
+   *
+   * @return Void.
+   */
+  void send() {
+    while (_server && _in_flight < LOG_EXPORT_WINDOW) {
+      if (_chunk_length == 0 && _file) {
+        _chunk_length = fill_chunk();
+        if (_chunk_length == 0) {
+          fclose(_file);
+          _file = NULL;
+        }
+      }
+
+      ble_error_t error = _server->write(_characteristic.getValueHandle(),
+                                         _chunk, _chunk_length);
+      if (error) {
+        // Stack buffers are full, retry once a notification has been sent,
+        // or after a delay if none of ours will be
+        if (_in_flight == 0 && !_retry.schedule(this, &LogExporter::retry)) {
+          printf("> Log export abandoned after %u bytes\n", _sent_bytes);
+          stop();
+        }
+        return;
+      }
+      _retry.succeeded();
+      _in_flight++;
+
+      if (_chunk_length == 0) {
+        _timer.stop();
+        printf("> Exported %u bytes of logs in %lld ms\n", _sent_bytes,
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   _timer.elapsed_time())
+                   .count());
+        _server = NULL;
+        return;
+      }
+      _sent_bytes += _chunk_length;
+      _chunk_length = 0;
+    }
+  }
+};
+
 /**
  * @brief A handler for the BLE input event.
  */
@@ -305,14 +1002,45 @@ public:
    *
    * @return Instance of BLEInputHandler.
    */
-  BLEInputHandler(SmartLock *smart_lock) {
+  BLEInputHandler(LockBank *lock_bank, ProfiledEventQueue *event_queue,
+                  mbed::Callback<void(int)> on_enroll)
+      : _on_enroll(on_enroll),
+        _log_exporter(0xA002,
+                      GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY,
+                      event_queue),
+        _log_query(0xA003,
+                   GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE |
+                       GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY,
+                   event_queue),
+        _queue_stats(0xA005, event_queue) {
+    // The log names devices and unlocks, so only paired clients may read it
+    LogExporter *exporters[] = {&_log_exporter, &_log_query};
+    for (LogExporter *exporter : exporters) {
+      exporter->characteristic()->setSecurityRequirements(
+          GattCharacteristic::SecurityRequirement_t::AUTHENTICATED,
+          GattCharacteristic::SecurityRequirement_t::AUTHENTICATED,
+          GattCharacteristic::SecurityRequirement_t::AUTHENTICATED);
+    }
     uint8_t inputValue[6];
     _input_characteristic =
         new WriteOnlyArrayGattCharacteristic<uint8_t, sizeof(inputValue)>(
             0xA000, inputValue);
-    _smart_lock = smart_lock;
+    uint8_t lockInputValue[LOCK_INPUT_MAX_LENGTH];
+    _lock_input_characteristic =
+        new WriteOnlyArrayGattCharacteristic<uint8_t, sizeof(lockInputValue)>(
+            0xA004, lockInputValue);
+    uint8_t enrollValue[7];
+    _enroll_characteristic =
+        new WriteOnlyArrayGattCharacteristic<uint8_t, sizeof(enrollValue)>(
+            0xA006, enrollValue);
+    uint8_t commandValue[LOCK_COMMAND_MAX_LENGTH];
+    _command_characteristic =
+        new WriteOnlyArrayGattCharacteristic<uint8_t, sizeof(commandValue)>(
+            0xA007, commandValue);
+    _lock_bank = lock_bank;
 
-    if (!_input_characteristic) {
+    if (!_input_characteristic || !_lock_input_characteristic ||
+        !_enroll_characteristic || !_command_characteristic) {
       printf("Allocation of ReadWriteGattCharacteristic failed\r\n");
     }
   }
@@ -325,105 +1053,552 @@ public:
    * @return Void.
    */
   void start(BLE &ble, events::EventQueue &event_queue) {
-    GattCharacteristic *characteristics[] = {_input_characteristic};
-    GattService input_service(0xA001, characteristics, 1);
+    _ble = &ble;
+    GattCharacteristic *characteristics[] = {
+        _input_characteristic, _log_exporter.characteristic(),
+        _log_query.characteristic(), _lock_input_characteristic,
+        _queue_stats.characteristic(), _enroll_characteristic,
+        _command_characteristic};
+    GattService input_service(0xA001, characteristics,
+                              sizeof(characteristics) /
+                                  sizeof(characteristics[0]));
 
     ble.gattServer().addService(input_service);
     ble.gattServer().setEventHandler(this);
   }
 
+  /**
+   * @brief Called when a client connects.
+   *
+   * @param address The address of the client.
+   * @return Void.
+   */
+  void connect(const char *address) {
+    strncpy(_peer_address, address, DEVICE_ADDRESS_LENGTH);
+    _peer_address[DEVICE_ADDRESS_LENGTH] = '\0';
+  }
+
+  /**
+   * @brief Called when a bonded client's link is authenticated.
+   *
+   * @param identity The identity address of the client.
+   * @return Void.
+   */
+  void identify(const char *identity) {
+    strncpy(_peer_identity, identity, DEVICE_ADDRESS_LENGTH);
+    _peer_identity[DEVICE_ADDRESS_LENGTH] = '\0';
+  }
+
+  /**
+   * @brief Called when the client disconnects.
+   *
+   * @return Void.
+   */
+  void stop() {
+    _log_exporter.stop();
+    _log_exporter.reset_mtu();
+    _log_query.stop();
+    _log_query.reset_mtu();
+    _queue_stats.stop();
+    _queue_stats.reset_mtu();
+    _peer_address[0] = '\0';
+    _peer_identity[0] = '\0';
+  }
+
 private:
   /**
    * @brief The GATT Characteristic that communicates the input.
    */
   WriteOnlyArrayGattCharacteristic<uint8_t, 6> *_input_characteristic;
-  SmartLock *_smart_lock;
+  /**
+   * @brief The GATT Characteristic that communicates input for a lock index.
+   */
+  WriteOnlyArrayGattCharacteristic<uint8_t, LOCK_INPUT_MAX_LENGTH>
+      *_lock_input_characteristic;
+  /**
+   * @brief The GATT Characteristic that requests the enrollment QR code.
+   */
+  WriteOnlyArrayGattCharacteristic<uint8_t, 7> *_enroll_characteristic;
+  /**
+   * @brief The GATT Characteristic that runs a command on a lock.
+   */
+  WriteOnlyArrayGattCharacteristic<uint8_t, LOCK_COMMAND_MAX_LENGTH>
+      *_command_characteristic;
+  mbed::Callback<void(int)> _on_enroll;
+  LockBank *_lock_bank;
+  LogExporter _log_exporter;
+  LogExporter _log_query;
+  QueueStatsExporter _queue_stats;
+  BLE *_ble = NULL;
+  char _peer_address[DEVICE_ADDRESS_LENGTH + 1] = "";
+  // The identity address of a bonded client, empty until it is known
+  char _peer_identity[DEVICE_ADDRESS_LENGTH + 1] = "";
+  /**
+   * @brief Incorrect codes since the last correct code or lockout. Kept
+   * across connections so reconnecting does not reset it.
+   */
+  int _failed_codes = 0;
+  Kernel::Clock::time_point _codes_locked_until;
 
   /**
-   * This callback doesn't do anything right now except print whatever is
-   * written.
+   * @brief Checks whether codes are being refused after too many incorrect
+   * codes. Every code counts, as the unsynced TOTP window accepts
+   * 2 * unsynced-totp-window + 1 codes at once.
    *
-   * @param params Information about the characterisitc being updated.
+   * @return True if codes are being refused.
+   */
+  bool codes_locked_out() {
+    Kernel::Clock::time_point now = Kernel::Clock::now();
+    if (now >= _codes_locked_until) {
+      return false;
+    }
+    printf("> Codes refused for another %lld ms\n",
+           std::chrono::duration_cast<std::chrono::milliseconds>(
+               _codes_locked_until - now)
+               .count());
+    return true;
+  }
+
+  /**
+   * @brief Counts a checked code, refusing codes for code-lockout-ms after
+   * code-attempt-limit incorrect codes in a row.
+   *
+   * @param valid Whether the code was correct.
    * @return Void.
    */
-  void onDataWritten(const GattWriteCallbackParams &params) override {
-    if (params.handle == _input_characteristic->getValueHandle()) {
-      if (params.len != 3 and params.len != 6) {
-        printf("> Received code has incorrect length\n");
+  void record_code_result(bool valid) {
+    if (valid) {
+      _failed_codes = 0;
+      return;
+    }
+    if (++_failed_codes < MBED_CONF_APP_CODE_ATTEMPT_LIMIT) {
+      return;
+    }
+    _failed_codes = 0;
+    _codes_locked_until =
+        Kernel::Clock::now() +
+        std::chrono::milliseconds(MBED_CONF_APP_CODE_LOCKOUT_MS);
+    char log_message[80];
+    sprintf(log_message, "Codes refused for %d ms after %d incorrect codes",
+            MBED_CONF_APP_CODE_LOCKOUT_MS, MBED_CONF_APP_CODE_ATTEMPT_LIMIT);
+    write_log(log_message);
+  }
+
+  /**
+   * @brief Checks that a link is encrypted with keys from authenticated
+   * pairing. The stack enforces this on protected characteristics already.
+   *
+   * @param connection The connection.
+   * @return True if the link is authenticated.
+   */
+  bool is_link_authenticated(ble::connection_handle_t connection) {
+    ble::link_encryption_t encryption(ble::link_encryption_t::NOT_ENCRYPTED);
+    if (_ble->securityManager().getLinkEncryption(connection, &encryption)) {
+      return false;
+    }
+    return encryption == ble::link_encryption_t::ENCRYPTED_WITH_MITM ||
+           encryption == ble::link_encryption_t::ENCRYPTED_WITH_SC_AND_MITM;
+  }
+
+  /**
+   * @brief Answers a log query with the matching records.
+   *
+   * A query holds the earliest and latest record times as little endian
+   * 32-bit epochs (0 for unbounded), a log_event_t mask (0 for all) and an
+   * optional 6 byte device address, most significant byte first.
+   *
+   * @param connection The connection the query came from.
+   * @param data The query.
+   * @param length The length of the query.
+   * @return Void.
+   */
+  void query_logs(ble::connection_handle_t connection, const uint8_t *data,
+                  uint16_t length) {
+    if (!is_link_authenticated(connection)) {
+      printf("> Log query refused on an unauthenticated link\n");
+      return;
+    }
+    if (length != LOG_QUERY_LENGTH && length != LOG_QUERY_DEVICE_LENGTH) {
+      printf("> Received log query has incorrect length\n");
+      return;
+    }
+
+    log_filter_t filter;
+    filter.from = read_le32(data);
+    filter.to = read_le32(data + 4);
+    filter.events = data[8];
+    filter.device[0] = '\0';
+    if (length == LOG_QUERY_DEVICE_LENGTH) {
+      sprintf(filter.device, "%02x:%02x:%02x:%02x:%02x:%02x", data[9],
+              data[10], data[11], data[12], data[13], data[14]);
+    }
+
+    printf("> Answering log query\n");
+    _log_query.start(_ble->gattServer(), &filter);
+  }
+
+  /**
+   * @brief Starts the log export when a client subscribes to it.
+   *
+   * @param params Information about the subscribed characteristic.
+   * @return Void.
+   */
+  void
+  onUpdatesEnabled(const GattUpdatesEnabledCallbackParams &params) override {
+    if (params.attHandle ==
+        _log_exporter.characteristic()->getValueHandle()) {
+      if (!is_link_authenticated(params.connHandle)) {
+        printf("> Log export refused on an unauthenticated link\n");
         return;
       }
+      write_log("Log export started");
+      _log_exporter.start(_ble->gattServer());
+    } else if (params.attHandle ==
+               _queue_stats.characteristic()->getValueHandle()) {
+      _queue_stats.start(_ble->gattServer());
+    }
+  }
 
-      char *code = (char *)malloc(7);
-      if (params.len == 6) {
-        int index = 0;
-        for (int i = 0; i < params.len; i++) {
-          index += sprintf(&code[index], "%c", params.data[i]);
-        }
-        code[6] = '\0';
-      } else if (params.len == 3) {
-        int index = 0;
-        for (int i = 0; i < params.len; i++) {
-          index += sprintf(&code[index], "%02x", params.data[i]);
-        }
-        code[6] = '\0';
-      }
+  /**
+   * @brief Stops the log export when the client unsubscribes.
+   *
+   * @param params Information about the unsubscribed characteristic.
+   * @return Void.
+   */
+  void
+  onUpdatesDisabled(const GattUpdatesDisabledCallbackParams &params) override {
+    if (params.attHandle ==
+        _log_exporter.characteristic()->getValueHandle()) {
+      _log_exporter.stop();
+    } else if (params.attHandle ==
+               _log_query.characteristic()->getValueHandle()) {
+      _log_query.stop();
+    } else if (params.attHandle ==
+               _queue_stats.characteristic()->getValueHandle()) {
+      _queue_stats.stop();
+    }
+  }
+
+  /**
+   * @brief Continues the log export once a notification has been sent.
+   *
+   * @param params Information about the sent notification.
+   * @return Void.
+   */
+  void onDataSent(const GattDataSentCallbackParams &params) override {
+    if (params.attHandle ==
+        _log_exporter.characteristic()->getValueHandle()) {
+      _log_exporter.on_sent();
+    } else if (params.attHandle ==
+               _log_query.characteristic()->getValueHandle()) {
+      _log_query.on_sent();
+    }
+    _queue_stats.on_sent(params.attHandle ==
+                         _queue_stats.characteristic()->getValueHandle());
+  }
 
-      printf("> Received code %s\n", code);
+  /**
+   * @brief Resizes log export chunks to the negotiated ATT MTU.
+   *
+   * @param connectionHandle The connection whose MTU changed.
+   * @param attMtuSize The new ATT MTU.
+   * @return Void.
+   */
+  void onAttMtuChange(ble::connection_handle_t connectionHandle,
+                      uint16_t attMtuSize) override {
+    printf("> ATT MTU changed to %u\n", attMtuSize);
+    _log_exporter.set_mtu(attMtuSize);
+    _log_query.set_mtu(attMtuSize);
+    _queue_stats.set_mtu(attMtuSize);
+  }
 
-      if (_smart_lock->is_unlocked()) {
-        printf("> SmartLock already unlocked\n");
-        return;
+  /**
+   * @brief Shows the enrollment QR code of a lock if a valid TOTP code for
+   * the lock or an unused recovery key is given. The recovery key is used up.
+   *
+   * @param data The code as 6 characters or 3 bytes, after the index of the
+   * lock for any lock but lock 0.
+   * @param length The length of the code and index.
+   * @return Void.
+   */
+  void request_enrollment(const uint8_t *data, uint16_t length) {
+    int index = 0;
+    if (length == 4 || length == 7) {
+      index = data[0];
+      data++;
+      length--;
+    }
+    if (length != 3 and length != 6) {
+      printf("> Received code has incorrect length\n");
+      return;
+    }
+    if (!_lock_bank->get(index)) {
+      printf("> Received code for unknown lock %d\n", index);
+      return;
+    }
+
+    if (codes_locked_out()) {
+      return;
+    }
+
+    char code[7];
+    read_code(data, length, code);
+
+    bool valid;
+    if (digits_only(code)) {
+      uint8_t key[PRIVATE_KEY_SIZE];
+      uint8_t secret[PRIVATE_KEY_SIZE];
+      get_private_key(key);
+      derive_lock_secret(key, index, secret);
+      valid = validate(secret, code);
+    } else {
+      int slot = find_recovery_key(code);
+      valid = slot != -1;
+      if (valid) {
+        consume_recovery_key(slot);
       }
+    }
+    record_code_result(valid);
 
-      char log_message[50];
-      if (digits_only(code)) {
-        char secret[PRIVATE_KEY_LENGTH + 1];
-        get_private_key(secret);
-
-        if (validate(secret, code)) {
-          sprintf(log_message, "Received valid TOTP code: %s", code);
-          write_log(log_message);
-          _smart_lock->unlock();
-        } else {
-          printf("> Received code is incorrect\n");
-          sprintf(log_message, "Received invalid TOTP code: %s", code);
-          write_log(log_message);
+    char log_message[80];
+    if (valid) {
+      sprintf(log_message, "Enrollment code requested by %s for lock %d",
+              _peer_address, index);
+    } else {
+      printf("> Received incorrect code\n");
+      sprintf(log_message, "Received invalid enrollment code from %s",
+              _peer_address);
+    }
+    write_log(log_message);
+    if (valid && _on_enroll) {
+      _on_enroll(index);
+    }
+  }
+
+  /**
+   * @brief Runs a validated command on a lock.
+   *
+   * @param smart_lock The lock.
+   * @param command The command.
+   * @param argument The argument of the command.
+   * @return Void.
+   */
+  void apply_command(SmartLock *smart_lock, lock_command_t command,
+                     uint16_t argument) {
+    switch (command) {
+    case LOCK_COMMAND_UNLOCK:
+      smart_lock->unlock();
+      break;
+    case LOCK_COMMAND_EXTEND:
+      smart_lock->extend_relock();
+      break;
+    case LOCK_COMMAND_HOLD_OPEN:
+      smart_lock->hold_open();
+      break;
+    case LOCK_COMMAND_LOCK:
+      smart_lock->lock();
+      break;
+    case LOCK_COMMAND_SET_DELAY:
+      smart_lock->set_relock_delay(std::chrono::seconds(argument));
+      printf("> SmartLock %d relocks after %u s\n", smart_lock->index(),
+             argument);
+      break;
+    default:
+      break;
+    }
+  }
+
+  /**
+   * @brief Records and prints the time from a code arriving to its lock
+   * being driven open. Nothing is printed before the lock is driven, as the
+   * console may be held by a log dump.
+   *
+   * @param smart_lock The lock that was unlocked.
+   * @param received_us When the stack signalled the code, in microseconds of
+   * the us ticker.
+   * @return Void.
+   */
+  void record_unlock_latency(SmartLock *smart_lock, uint64_t received_us) {
+    uint32_t latency = smart_lock->driven_at() - received_us;
+    latency_record(&unlock_latency, latency);
+    printf("> Lock %d driven %lu us after the code arrived\n",
+           smart_lock->index(), (unsigned long)latency);
+  }
+
+  /**
+   * @brief Validates a code and unlocks a lock if it is valid.
+   *
+   * @param connection The connection the code came from.
+   * @param index The index of the lock.
+   * @param data The code as 6 characters or 3 bytes.
+   * @param length The length of the code.
+   * @return Void.
+   */
+  void submit_code(ble::connection_handle_t connection, int index,
+                   const uint8_t *data, uint16_t length) {
+    submit_command(connection, index, LOCK_COMMAND_UNLOCK, 0, data, length);
+  }
+
+  /**
+   * @brief Validates a code and runs a command on a lock if it is valid.
+   *
+   * @param connection The connection the command came from.
+   * @param index The index of the lock.
+   * @param command The command.
+   * @param argument The argument of the command.
+   * @param data The code as 6 characters or 3 bytes.
+   * @param length The length of the code.
+   * @return Void.
+   */
+  void submit_command(ble::connection_handle_t connection, int index,
+                      lock_command_t command, uint16_t argument,
+                      const uint8_t *data, uint16_t length) {
+    // Events processed without a signal are timed from now
+    uint64_t received_us = ble_events_signalled_us
+                               ? ble_events_signalled_us
+                               : ticker_read_us(get_us_ticker_data());
+
+    if (length != 3 and length != 6) {
+      printf("> Received code has incorrect length\n");
+      return;
+    }
+
+    SmartLock *smart_lock = _lock_bank->get(index);
+    if (!smart_lock) {
+      printf("> Received code for unknown lock %d\n", index);
+      return;
+    }
+
+    // Checked before the code, so a bad command never uses up a recovery key
+    if (command >= LOCK_COMMAND_COUNT ||
+        (command == LOCK_COMMAND_SET_DELAY &&
+         (argument == 0 || argument > LOCK_COMMAND_MAX_DELAY_S))) {
+      printf("> Received invalid command %d for lock %d\n", command, index);
+      return;
+    }
+
+    if (codes_locked_out()) {
+      return;
+    }
+
+    char code[7];
+    read_code(data, length, code);
+
+    if (command == LOCK_COMMAND_UNLOCK && smart_lock->is_unlocked()) {
+      printf("> SmartLock %d already unlocked\n", index);
+      return;
+    }
+
+    char log_message[80];
+    // Lock users are bonded identities, which only count on a link encrypted
+    // with the keys from authenticated pairing
+    const char *identity =
+        is_link_authenticated(connection) ? _peer_identity : "";
+    if (!smart_lock->is_authorized(identity)) {
+      printf("> Device not authorized for lock %d\n", index);
+      sprintf(log_message,
+              "Received invalid code from unauthorized %s on lock %d",
+              _peer_address, index);
+      write_log(log_message);
+      return;
+    }
+
+    if (digits_only(code)) {
+      uint8_t key[PRIVATE_KEY_SIZE];
+      uint8_t secret[PRIVATE_KEY_SIZE];
+      get_private_key(key);
+      derive_lock_secret(key, index, secret);
+
+      bool valid = validate(secret, code);
+      record_code_result(valid);
+      if (valid) {
+        apply_command(smart_lock, command, argument);
+        if (command == LOCK_COMMAND_UNLOCK) {
+          record_unlock_latency(smart_lock, received_us);
         }
+        sprintf(log_message, "Received valid TOTP code from %s on lock %d",
+                _peer_address, index);
+        write_log(log_message);
       } else {
-        char secret[RECOVERY_KEY_LENGTH + 1];
-        get_recovery_keys(secret);
-
-        char recovery_key[7];
-        for (int key = 0; key < RECOVERY_KEY_LENGTH; key += 6) {
-          strncpy(recovery_key, secret + key, 6);
-          recovery_key[6] = '\0';
-
-          if (strcmp(recovery_key, code) == 0) {
-            sprintf(log_message, "Received valid recovery code: %s", code);
-            write_log(log_message);
-            _smart_lock->unlock();
-
-            strncpy(secret + key, "000000", 6);
-            set_recovery_keys(secret);
-            sprintf(log_message, "Removed recovery code: %s", code);
-            return;
-          }
+        printf("> Received code is incorrect\n");
+        sprintf(log_message, "Received invalid TOTP code from %s on lock %d",
+                _peer_address, index);
+        write_log(log_message);
+      }
+    } else {
+      int slot = find_recovery_key(code);
+      record_code_result(slot != -1);
+      if (slot != -1) {
+        apply_command(smart_lock, command, argument);
+        if (command == LOCK_COMMAND_UNLOCK) {
+          record_unlock_latency(smart_lock, received_us);
         }
-
+        sprintf(log_message, "Received valid recovery code from %s on lock %d",
+                _peer_address, index);
+        write_log(log_message);
+        consume_recovery_key(slot);
+      } else {
         printf("> Received incorrect code\n");
-        sprintf(log_message, "Received invalid recovery code: %s", code);
+        sprintf(log_message,
+                "Received invalid recovery code from %s on lock %d",
+                _peer_address, index);
         write_log(log_message);
       }
     }
   }
+
+  /**
+   * @brief Dispatches writes to the input, lock input and log query
+   * characteristics.
+   *
+   * @param params Information about the characterisitc being updated.
+   * @return Void.
+   */
+  void onDataWritten(const GattWriteCallbackParams &params) override {
+    TRACE_SCOPE(TRACE_DATA_WRITTEN, params.len);
+    if (params.handle == _log_query.characteristic()->getValueHandle()) {
+      query_logs(params.connHandle, params.data, params.len);
+    } else if (params.handle == _input_characteristic->getValueHandle()) {
+      submit_code(params.connHandle, 0, params.data, params.len);
+    } else if (params.handle ==
+               _lock_input_characteristic->getValueHandle()) {
+      if (params.len < 1) {
+        printf("> Received code has incorrect length\n");
+        return;
+      }
+      submit_code(params.connHandle, params.data[0], params.data + 1,
+                  params.len - 1);
+    } else if (params.handle == _enroll_characteristic->getValueHandle()) {
+      request_enrollment(params.data, params.len);
+    } else if (params.handle == _command_characteristic->getValueHandle()) {
+      if (params.len < LOCK_COMMAND_HEADER_LENGTH) {
+        printf("> Received command has incorrect length\n");
+        return;
+      }
+      submit_command(params.connHandle, params.data[0],
+                     (lock_command_t)params.data[1],
+                     params.data[2] | params.data[3] << 8,
+                     params.data + LOCK_COMMAND_HEADER_LENGTH,
+                     params.len - LOCK_COMMAND_HEADER_LENGTH);
+    }
+  }
 };
 
-int init_bluetooth(events::EventQueue &event_queue, SmartLock *smart_lock) {
+void print_ble_stats() {
+  latency_print(&unlock_latency, "Code to unlock latency");
+}
+
+int init_bluetooth(ProfiledEventQueue &event_queue, LockBank *lock_bank,
+                   mbed::Callback<void(int)> on_enroll) {
   BLE &ble = BLE::Instance();
-  BLEInputHandler inputHandler(smart_lock);
+  BLEInputHandler inputHandler(lock_bank, &event_queue, on_enroll);
   SmartLockBLEProcess ble_process(event_queue, ble);
 
   ble_process.on_init(callback(&inputHandler, &BLEInputHandler::start));
+  ble_process.on_connect(callback(&inputHandler, &BLEInputHandler::connect));
+  ble_process.on_disconnect(callback(&inputHandler, &BLEInputHandler::stop));
+  ble_process.on_identity(
+      callback(&inputHandler, &BLEInputHandler::identify));
   ble_process.start();
   return 0;
 }
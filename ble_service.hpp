@@ -11,25 +11,78 @@
 #define BLE_SERVICE_H
 
 #include "BLE.h"
+#include "boot_profile.hpp"
 #include "Gap.h"
+#include "codec.hpp"
 #include "datastore.hpp"
 #include "keys.hpp"
+#include "latency_histogram.hpp"
+#include "lock_bank.hpp"
 #include "mbed.h"
-#include "smartlock.hpp"
+#include "profiled_event_queue.hpp"
 #include "totp.hpp"
+#include "trace.hpp"
 #include <chrono>
 
 using namespace std::chrono_literals;
 
 const char DEVICE_NAME[10] = "SmartLock";
 static const uint16_t MAX_ADVERTISING_PAYLOAD_SIZE = 50;
+// Largest notification payload, an ATT MTU of 247 less the 3 byte header
+static const uint16_t LOG_EXPORT_MAX_CHUNK = 244;
+// Notifications handed to the stack before waiting for a sent event
+static const int LOG_EXPORT_WINDOW = 4;
+// Delay before resending a refused notification when none are in flight, as
+// no sent event will come to retry it
+static constexpr std::chrono::milliseconds EXPORT_RETRY_DELAY = 50ms;
+// Refusals in a row after which an export is abandoned
+static const int EXPORT_MAX_RETRIES = 20;
+// Log query: from (4), to (4), event mask (1), optional device address (6)
+static const uint16_t LOG_QUERY_LENGTH = 9;
+static const uint16_t LOG_QUERY_DEVICE_LENGTH = 15;
+// Lock input: lock index (1) followed by a 3 or 6 byte code
+static const uint16_t LOCK_INPUT_MAX_LENGTH = 7;
+// Lock command: lock index (1), command (1), little endian argument (2)
+// followed by a 3 or 6 byte code
+static const uint16_t LOCK_COMMAND_HEADER_LENGTH = 4;
+static const uint16_t LOCK_COMMAND_MAX_LENGTH = 10;
+// Longest relock delay a command can set, in seconds
+static const uint16_t LOCK_COMMAND_MAX_DELAY_S = 3600;
+
+/**
+ * @brief The commands accepted by the lock command characteristic.
+ */
+enum lock_command_t {
+  LOCK_COMMAND_UNLOCK,    // Unlock until the relock delay passes
+  LOCK_COMMAND_EXTEND,    // Restart the relock delay of an unlocked lock
+  LOCK_COMMAND_HOLD_OPEN, // Unlock until locked by a command
+  LOCK_COMMAND_LOCK,      // Lock now, cancelling any relock
+  LOCK_COMMAND_SET_DELAY, // Set the relock delay to the argument in seconds
+  LOCK_COMMAND_COUNT
+};
+// Queue statistics: site name, peak depth (2), wait and run histograms (60
+// each)
+static const uint16_t QUEUE_STATS_RECORD_LENGTH =
+    QUEUE_SITE_NAME_LENGTH + 2 + 2 * (12 + 2 * LATENCY_BUCKETS);
+
+/**
+ * @brief Prints the latency from receiving a valid code to unlocking.
+ *
+ * @return Void.
+ */
+void print_ble_stats();
 
 /**
  * @brief Initialize the bluetooth server and input handler.
  *
  * @param event_queue The global event queue.
+ * @param lock_bank The locks opened by valid codes.
+ * @param on_enroll Called with the index of a lock when a client sends a
+ * valid code for it to the enrollment characteristic, to show the lock's
+ * enrollment QR code.
  * @return 0 upon success, -1 on error / failure.
  */
-int init_bluetooth(events::EventQueue &event_queue, SmartLock *smart_lock);
+int init_bluetooth(ProfiledEventQueue &event_queue, LockBank *lock_bank,
+                   mbed::Callback<void(int)> on_enroll);
 
 #endif // BLE_SERVICE_H
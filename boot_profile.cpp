@@ -0,0 +1,163 @@
+/**
+ * @file boot_profile.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains functionality for timing the phases of a boot
+ * and keeping the timings of recent boots.
+ * @bug No known bugs.
+ */
+#include "boot_profile.hpp"
+
+using namespace std::chrono;
+
+static const char *const BOOT_PHASE_NAMES[BOOT_PHASE_COUNT] = {
+    "mount", "recovery keys", "private key", "qr",
+    "wifi",  "ntp",           "advertising"};
+static const char *const ERASE_MODE_NAMES[] = {"quick", "deep"};
+
+static boot_record_t current_boot;
+static EventQueue *boot_profile_queue = NULL;
+
+/**
+ * @brief Reads the stored boot records.
+ *
+ * @param records The array to read into, BOOT_HISTORY_LENGTH long.
+ * @return The number of valid records, which are moved to the front of the
+ * array in boot order.
+ */
+static int read_boot_records(boot_record_t *records) {
+  FILE *f = fopen(BOOT_PROFILE_PATH, "rb");
+  if (!f) {
+    return 0;
+  }
+  int count = 0;
+  boot_record_t record;
+  while (count < BOOT_HISTORY_LENGTH &&
+         fread(&record, sizeof(record), 1, f) == 1) {
+    if (record.magic != BOOT_PROFILE_MAGIC ||
+        record.crc != crc32(&record, offsetof(boot_record_t, crc))) {
+      continue;
+    }
+    // Insertion sort, the history is short
+    int i = count++;
+    while (i > 0 && records[i - 1].boot_count > record.boot_count) {
+      records[i] = records[i - 1];
+      i--;
+    }
+    records[i] = record;
+  }
+  fclose(f);
+  return count;
+}
+
+/**
+ * @brief Stores the record of this boot over the oldest stored record the
+ * first time it is called, and rewrites the same slot after that.
+ *
+ * @return Void.
+ */
+static void save_boot_record() {
+  bool first_save = current_boot.magic != BOOT_PROFILE_MAGIC;
+  if (first_save) {
+    boot_record_t records[BOOT_HISTORY_LENGTH];
+    int count = read_boot_records(records);
+    current_boot.boot_count = count ? records[count - 1].boot_count + 1 : 0;
+    current_boot.firmware_version = MBED_CONF_APP_FIRMWARE_VERSION;
+    current_boot.magic = BOOT_PROFILE_MAGIC;
+  }
+  current_boot.crc = crc32(&current_boot, offsetof(boot_record_t, crc));
+
+  FILE *f = fopen(BOOT_PROFILE_PATH, "r+b");
+  if (!f) {
+    f = fopen(BOOT_PROFILE_PATH, "w+b");
+  }
+  if (!f) {
+    printf("Cannot open file for write %s: %s\n", BOOT_PROFILE_PATH,
+           strerror(errno));
+    return;
+  }
+  long slot = current_boot.boot_count % BOOT_HISTORY_LENGTH;
+  if (fseek(f, slot * sizeof(boot_record_t), SEEK_SET) != 0 ||
+      fwrite(&current_boot, sizeof(current_boot), 1, f) != 1) {
+    printf("Cannot write %s: %s\n", BOOT_PROFILE_PATH, strerror(errno));
+  }
+  fclose(f);
+
+  if (!first_save) {
+    return;
+  }
+  uint32_t advertising_ms = current_boot.phase_end_ms[BOOT_PHASE_ADVERTISING];
+  if (current_boot.erase_ms) {
+    // The reset itself is not timed, it takes a few milliseconds at most
+    printf("> Advertising %lu ms after power on, %lu ms after the %s erase "
+           "started\n",
+           (unsigned long)advertising_ms,
+           (unsigned long)(current_boot.erase_ms + advertising_ms),
+           ERASE_MODE_NAMES[current_boot.erase_mode]);
+  } else {
+    printf("> Advertising %lu ms after power on\n",
+           (unsigned long)advertising_ms);
+  }
+}
+
+void boot_profile_init(EventQueue *queue) {
+  boot_profile_queue = queue;
+  erase_record_t erase;
+  if (take_erase_record(&erase) == 0 && erase.mode <= ERASE_DEEP) {
+    // 0 marks a boot that did not follow an erase
+    current_boot.erase_ms = erase.ms ? erase.ms : 1;
+    current_boot.erase_mode = erase.mode;
+  }
+}
+
+void boot_phase_end(boot_phase_t phase) {
+  if (current_boot.phase_end_ms[phase]) {
+    return;
+  }
+  uint32_t ms =
+      duration_cast<milliseconds>(Kernel::Clock::now().time_since_epoch())
+          .count();
+  // 0 marks a phase that did not run
+  current_boot.phase_end_ms[phase] = ms ? ms : 1;
+
+  // Wifi and NTP run on the network thread and often end after the first
+  // advertisement, so their ends update the stored record
+  if (phase == BOOT_PHASE_ADVERTISING ||
+      current_boot.phase_end_ms[BOOT_PHASE_ADVERTISING]) {
+    if (!boot_profile_queue || !boot_profile_queue->call(save_boot_record)) {
+      save_boot_record();
+    }
+  }
+}
+
+int print_boot_profile() {
+  boot_record_t records[BOOT_HISTORY_LENGTH];
+  int count = read_boot_records(records);
+  if (!count) {
+    printf("> No boot profile recorded\n");
+    return -1;
+  }
+
+  printf("> Boot phases, in ms after power on:\n");
+  for (int i = 0; i < count; i++) {
+    printf("Boot %lu (firmware %lu):", (unsigned long)records[i].boot_count,
+           (unsigned long)records[i].firmware_version);
+    for (int phase = 0; phase < BOOT_PHASE_ADVERTISING; phase++) {
+      if (records[i].phase_end_ms[phase]) {
+        printf(" %s %lu,", BOOT_PHASE_NAMES[phase],
+               (unsigned long)records[i].phase_end_ms[phase]);
+      }
+    }
+    printf(" first advertisement %lu",
+           (unsigned long)records[i].phase_end_ms[BOOT_PHASE_ADVERTISING]);
+    if (records[i].erase_ms && records[i].erase_mode <= ERASE_DEEP) {
+      printf(", after a %s erase of %lu",
+             ERASE_MODE_NAMES[records[i].erase_mode],
+             (unsigned long)records[i].erase_ms);
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file boot_profile.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines functionality for timing the phases of a boot
+ * and keeping the timings of recent boots.
+ * @bug No known bugs.
+ */
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include "datastore.hpp"
+#include "mbed.h"
+
+#define BOOT_PROFILE_MAGIC 0x544F4F42 // "BOOT"
+#define BOOT_HISTORY_LENGTH 8
+
+/**
+ * @brief The phases of a boot, in the order main() used to run them.
+ */
+typedef enum {
+  BOOT_PHASE_MOUNT,
+  BOOT_PHASE_RECOVERY_KEYS,
+  BOOT_PHASE_PRIVATE_KEY,
+  BOOT_PHASE_QR,
+  BOOT_PHASE_WIFI,
+  BOOT_PHASE_NTP,
+  BOOT_PHASE_ADVERTISING,
+  BOOT_PHASE_COUNT
+} boot_phase_t;
+
+/**
+ * @brief The timings of one boot as they are stored in flash.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t boot_count;
+  uint32_t firmware_version;
+  // Milliseconds from the kernel starting to the end of each phase, 0 if the
+  // phase did not run
+  uint32_t phase_end_ms[BOOT_PHASE_COUNT];
+  // Milliseconds spent erasing before the reset that started this boot, 0 if
+  // the boot did not follow an erase
+  uint32_t erase_ms;
+  uint32_t erase_mode;
+  uint32_t crc;
+} boot_record_t;
+
+/**
+ * @brief Sets the queue that stores the boot record once the device is
+ * advertising, so the write does not hold up the first connection, and
+ * updates it as later phases end. Takes the record of an erase that reset the
+ * device so it is reported with this boot.
+ *
+ * @param queue The queue that writes the boot record.
+ * @return Void.
+ */
+void boot_profile_init(events::EventQueue *queue);
+
+/**
+ * @brief Records that a phase of the boot has finished. Phases that end more
+ * than once keep their first end.
+ *
+ * @param phase The phase.
+ * @return Void.
+ */
+void boot_phase_end(boot_phase_t phase);
+
+/**
+ * @brief Prints the timings of the stored boots, oldest first, ending with
+ * the time from power on to the first advertisement and the erase that came
+ * before the boot, if any.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+int print_boot_profile();
+
+#endif // BOOT_PROFILE_H
@@ -0,0 +1,178 @@
+/**
+ * @file codec.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains table-driven hex and base32 conversions of byte
+ * buffers of any length. They never allocate and build on any platform.
+ * @bug No known bugs.
+ */
+#include "codec.hpp"
+#include <string.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+static constexpr char BASE32_DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+/**
+ * @brief Maps every character to its digit value, or -1 if it is not one.
+ */
+typedef struct {
+  int8_t values[256];
+} decode_table_t;
+
+/**
+ * @brief Builds a decode table at compile time, so it is kept in flash.
+ *
+ * @return The table.
+ */
+static constexpr decode_table_t make_decode_table(const char *digits,
+                                                  int count) {
+  decode_table_t table = {};
+  for (int i = 0; i < 256; i++) {
+    table.values[i] = -1;
+  }
+  for (int i = 0; i < count; i++) {
+    char digit = digits[i];
+    table.values[(uint8_t)digit] = i;
+    if (digit >= 'a' && digit <= 'z') {
+      table.values[(uint8_t)(digit - 'a' + 'A')] = i;
+    } else if (digit >= 'A' && digit <= 'Z') {
+      table.values[(uint8_t)(digit - 'A' + 'a')] = i;
+    }
+  }
+  return table;
+}
+
+static constexpr decode_table_t HEX_DECODE = make_decode_table(HEX_DIGITS, 16);
+static constexpr decode_table_t BASE32_DECODE =
+    make_decode_table(BASE32_DIGITS, 32);
+
+int bytes_to_hex(const uint8_t *bytes, size_t length, char *text,
+                 size_t size) {
+  if (size < HEX_LENGTH(length) + 1) {
+    return -1;
+  }
+  for (size_t i = 0; i < length; i++) {
+    text[i * 2] = HEX_DIGITS[bytes[i] >> 4];
+    text[i * 2 + 1] = HEX_DIGITS[bytes[i] & 0x0F];
+  }
+  text[HEX_LENGTH(length)] = '\0';
+  return HEX_LENGTH(length);
+}
+
+int hex_to_bytes(const char *text, size_t length, uint8_t *bytes,
+                 size_t size) {
+  if (length % 2 || size < length / 2) {
+    return -1;
+  }
+  for (size_t i = 0; i < length / 2; i++) {
+    int high = HEX_DECODE.values[(uint8_t)text[i * 2]];
+    int low = HEX_DECODE.values[(uint8_t)text[i * 2 + 1]];
+    if (high < 0 || low < 0) {
+      return -1;
+    }
+    bytes[i] = high << 4 | low;
+  }
+  return length / 2;
+}
+
+int bytes_to_base32(const uint8_t *bytes, size_t length, char *text,
+                    size_t size) {
+  if (size < BASE32_LENGTH(length) + 1) {
+    return -1;
+  }
+  size_t count = 0;
+  size_t i = 0;
+#if defined(__SSSE3__)
+  // Host builds encode 10 bytes, a whole private key, to 16 digits at once.
+  // Each 16-bit lane gets the two bytes its digit is cut from, high byte
+  // first, and is shifted right by multiplying by 2^(16 - shift).
+  const __m128i windows =
+      _mm_setr_epi8(1, 0, 1, 0, 2, 1, 2, 1, 3, 2, 4, 3, 4, 3, 5, 4);
+  const __m128i next_group = _mm_set1_epi8(5);
+  const __m128i shifts =
+      _mm_setr_epi16(1 << 5, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6,
+                     1 << 11, 1 << 8);
+  const __m128i digit_mask = _mm_set1_epi16(0x1F);
+  const __m128i digits_low = _mm_loadu_si128((const __m128i *)BASE32_DIGITS);
+  const __m128i digits_high =
+      _mm_loadu_si128((const __m128i *)(BASE32_DIGITS + 16));
+  const __m128i fifteen = _mm_set1_epi8(15);
+  for (; i + 10 <= length; i += 10) {
+    // Loaded as 8 bytes and a 16-bit tail, so nothing past the input is read
+    uint16_t tail;
+    memcpy(&tail, bytes + i + 8, sizeof(tail));
+    __m128i in = _mm_insert_epi16(
+        _mm_loadl_epi64((const __m128i *)(bytes + i)), tail, 4);
+    __m128i first = _mm_shuffle_epi8(in, windows);
+    __m128i second = _mm_shuffle_epi8(in, _mm_add_epi8(windows, next_group));
+    first = _mm_and_si128(_mm_mulhi_epu16(first, shifts), digit_mask);
+    second = _mm_and_si128(_mm_mulhi_epu16(second, shifts), digit_mask);
+    __m128i values = _mm_packus_epi16(first, second);
+    // pshufb looks up 16 entries, so each half of the alphabet is looked up
+    __m128i high = _mm_cmpgt_epi8(values, fifteen);
+    __m128i low_digits = _mm_shuffle_epi8(digits_low, values);
+    __m128i high_digits = _mm_shuffle_epi8(digits_high, values);
+    __m128i digits = _mm_or_si128(_mm_andnot_si128(high, low_digits),
+                                  _mm_and_si128(high, high_digits));
+    _mm_storeu_si128((__m128i *)(text + count), digits);
+    count += 16;
+  }
+#endif
+  // Whole groups of 5 bytes become 8 digits
+  for (; i + 5 <= length; i += 5) {
+    uint64_t group = (uint64_t)bytes[i] << 32 | (uint64_t)bytes[i + 1] << 24 |
+                     (uint64_t)bytes[i + 2] << 16 |
+                     (uint64_t)bytes[i + 3] << 8 | bytes[i + 4];
+    for (int shift = 35; shift >= 0; shift -= 5) {
+      text[count++] = BASE32_DIGITS[(group >> shift) & 0x1F];
+    }
+  }
+  // The last bits are padded with zeros to a whole digit
+  uint32_t buffer = 0;
+  int bits = 0;
+  for (; i < length; i++) {
+    buffer = buffer << 8 | bytes[i];
+    bits += 8;
+    while (bits >= 5) {
+      bits -= 5;
+      text[count++] = BASE32_DIGITS[(buffer >> bits) & 0x1F];
+    }
+  }
+  if (bits > 0) {
+    text[count++] = BASE32_DIGITS[(buffer << (5 - bits)) & 0x1F];
+  }
+  text[count] = '\0';
+  return count;
+}
+
+int base32_to_bytes(const char *text, size_t length, uint8_t *bytes,
+                    size_t size) {
+  while (length > 0 && text[length - 1] == '=') {
+    length--;
+  }
+  if (size < length * 5 / 8) {
+    return -1;
+  }
+  uint32_t buffer = 0;
+  int bits = 0;
+  size_t count = 0;
+  for (size_t i = 0; i < length; i++) {
+    int value = BASE32_DECODE.values[(uint8_t)text[i]];
+    if (value < 0) {
+      return -1;
+    }
+    buffer = buffer << 5 | value;
+    bits += 5;
+    if (bits >= 8) {
+      bits -= 8;
+      bytes[count++] = buffer >> bits;
+    }
+  }
+  return count;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file codec.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines table-driven hex and base32 conversions of byte
+ * buffers of any length. They never allocate and build on any platform.
+ * @bug No known bugs.
+ */
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Characters needed for a number of bytes, not counting the NUL
+#define HEX_LENGTH(bytes) ((bytes)*2)
+#define BASE32_LENGTH(bytes) (((bytes)*8 + 4) / 5)
+
+/**
+ * @brief Encodes bytes as lowercase hex.
+ *
+ * @param bytes The bytes to encode.
+ * @param length The number of bytes.
+ * @param text The buffer to write to, NUL terminated.
+ * @param size The size of the buffer, at least HEX_LENGTH(length) + 1.
+ * @return The number of characters written, -1 if the buffer is too small.
+ */
+int bytes_to_hex(const uint8_t *bytes, size_t length, char *text,
+                 size_t size);
+
+/**
+ * @brief Decodes hex in either case.
+ *
+ * @param text The characters to decode.
+ * @param length The number of characters, which must be even.
+ * @param bytes The buffer to write to.
+ * @param size The size of the buffer, at least length / 2.
+ * @return The number of bytes written, -1 if the text is not hex or the
+ * buffer is too small.
+ */
+int hex_to_bytes(const char *text, size_t length, uint8_t *bytes,
+                 size_t size);
+
+/**
+ * @brief Encodes bytes as unpadded RFC 4648 base32, as used by otpauth URIs.
+ *
+ * @param bytes The bytes to encode.
+ * @param length The number of bytes.
+ * @param text The buffer to write to, NUL terminated.
+ * @param size The size of the buffer, at least BASE32_LENGTH(length) + 1.
+ * @return The number of characters written, -1 if the buffer is too small.
+ */
+int bytes_to_base32(const uint8_t *bytes, size_t length, char *text,
+                    size_t size);
+
+/**
+ * @brief Decodes RFC 4648 base32 in either case. Trailing '=' padding is
+ * accepted and leftover bits of a partial byte are dropped.
+ *
+ * @param text The characters to decode.
+ * @param length The number of characters.
+ * @param bytes The buffer to write to.
+ * @param size The size of the buffer, at least length * 5 / 8.
+ * @return The number of bytes written, -1 if the text is not base32 or the
+ * buffer is too small.
+ */
+int base32_to_bytes(const char *text, size_t length, uint8_t *bytes,
+                    size_t size);
+
+#endif // CODEC_H
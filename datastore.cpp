@@ -11,10 +11,84 @@
  */
 #include "datastore.hpp"
 
-BlockDevice *bd = BlockDevice::get_default_instance();
-LittleFileSystem fs("fs");
+using namespace std::chrono;
+
+#if MBED_CONF_APP_STORAGE_SIM
+HeapBlockDevice sim_bd(MBED_CONF_APP_STORAGE_SIM_SIZE, 1, 256, 4096);
+BlockDevice *storage_bd = &sim_bd;
+#else
+BlockDevice *storage_bd = BlockDevice::get_default_instance();
+#endif
+
+#if MBED_CONF_APP_STORAGE_PROFILE
+InstrumentedBlockDevice profiled_bd(storage_bd);
+BlockDevice *bd = &profiled_bd;
+#else
+BlockDevice *bd = storage_bd;
+#endif
+
+LittleFileSystem fs("fs", NULL, MBED_CONF_APP_LFS_READ_SIZE,
+                    MBED_CONF_APP_LFS_PROG_SIZE, MBED_CONF_APP_LFS_BLOCK_SIZE,
+                    MBED_CONF_APP_LFS_LOOKAHEAD);
+
+#if defined(TARGET_DISCO_L475VG_IOT01A)
+/**
+ * @brief Keeps the record of an erase in the RTC backup registers for the
+ * next boot. The highest registers are used, away from those the HAL uses.
+ *
+ * @param mode The erase mode.
+ * @param ms The time the erase took.
+ * @return Void.
+ */
+static void save_erase_record(erase_mode_t mode, uint32_t ms) {
+  HAL_PWR_EnableBkUpAccess();
+  RTC->BKP30R = ms;
+  RTC->BKP31R = (uint32_t)ERASE_RECORD_MAGIC << 16 | mode;
+}
+
+int take_erase_record(erase_record_t *record) {
+  uint32_t tag = RTC->BKP31R;
+  if (tag >> 16 != ERASE_RECORD_MAGIC) {
+    return -1;
+  }
+  record->mode = (erase_mode_t)(tag & 0xFFFF);
+  record->ms = RTC->BKP30R;
+  HAL_PWR_EnableBkUpAccess();
+  RTC->BKP31R = 0;
+  return 0;
+}
+#else
+static void save_erase_record(erase_mode_t, uint32_t) {}
+
+int take_erase_record(erase_record_t *) { return -1; }
+#endif
+
+/**
+ * @brief Checks whether a block of the block device is blank.
+ *
+ * @return 1 if blank, 0 if not, negative error code on failure.
+ */
+static int is_block_blank(bd_addr_t addr, bd_size_t size, int erase_value) {
+  static uint8_t buffer[ERASE_SCAN_BUFFER_SIZE];
+  for (bd_size_t offset = 0; offset < size; offset += sizeof(buffer)) {
+    bd_size_t chunk = size - offset < sizeof(buffer) ? size - offset
+                                                      : sizeof(buffer);
+    int err = bd->read(buffer, addr + offset, chunk);
+    if (err) {
+      return err;
+    }
+    for (bd_size_t i = 0; i < chunk; i++) {
+      if (buffer[i] != erase_value) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+void erase_fs(erase_mode_t mode) {
+  fs.unmount();
 
-void erase_fs() {
   printf("Initializing the block device... ");
   fflush(stdout);
   int err = bd->init();
@@ -23,13 +97,51 @@ void erase_fs() {
     error("error: %s (%d)\n", strerror(-err), err);
   }
 
-  printf("Erasing the block device... ");
-  fflush(stdout);
-  err = bd->erase(0, bd->size());
-  printf("%s\n", (err ? "Failed on erase" : "OK"));
+  int erase_value = bd->get_erase_value();
+  if (mode == ERASE_QUICK && erase_value < 0) {
+    printf("Erase value unknown, falling back to deep erase\n");
+    mode = ERASE_DEEP;
+  }
+
+  Timer erase_timer;
+  erase_timer.start();
+  int erased = 0;
+  int blocks = 0;
+  if (mode == ERASE_DEEP) {
+    printf("Erasing the block device... ");
+    fflush(stdout);
+    err = bd->erase(0, bd->size());
+    printf("%s\n", (err ? "Failed on erase" : "OK"));
+  } else {
+    printf("Erasing used blocks... ");
+    fflush(stdout);
+    for (bd_addr_t addr = 0; addr < bd->size() && !err;) {
+      bd_size_t size = bd->get_erase_size(addr);
+      int blank = is_block_blank(addr, size, erase_value);
+      if (blank < 0) {
+        err = blank;
+      } else if (!blank) {
+        err = bd->erase(addr, size);
+        erased++;
+      }
+      blocks++;
+      addr += size;
+    }
+    printf("%s\n", (err ? "Failed on erase" : "OK"));
+  }
   if (err) {
     error("error: %s (%d)\n", strerror(-err), err);
   }
+  uint32_t erase_ms =
+      duration_cast<milliseconds>(erase_timer.elapsed_time()).count();
+  if (mode == ERASE_DEEP) {
+    printf("> Deep erase took %lu ms\n", (unsigned long)erase_ms);
+  } else {
+    printf("> Quick erase of %d/%d blocks took %lu ms\n", erased, blocks,
+           (unsigned long)erase_ms);
+  }
+  // Reported with the first advertisement of the next boot
+  save_erase_record(mode, erase_ms);
 
   printf("Deinitializing the block device... ");
   fflush(stdout);
@@ -57,64 +169,492 @@ int mount_fs() {
   return 0;
 }
 
-int get_private_key(char *buf) {
-  FILE *f = fopen(PRIVATE_KEY_PATH, "r");
+/**
+ * @brief In-memory copy of the keystore record.
+ */
+static keystore_t keystore;
+static bool keystore_loaded = false;
+
+/**
+ * @brief Open addressed table of the unused recovery keys. Each entry holds a
+ * slot index plus one, 0 marks an empty bucket.
+ */
+#define RECOVERY_TABLE_SIZE 8
+static uint8_t recovery_table[RECOVERY_TABLE_SIZE];
+
+/**
+ * @brief Hashes a recovery key into a bucket of the recovery table.
+ */
+static int hash_recovery_key(const char *code) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < RECOVERY_KEY_SIZE; i++) {
+    hash = (hash ^ (uint8_t)code[i]) * 16777619u;
+  }
+  return hash & (RECOVERY_TABLE_SIZE - 1);
+}
+
+/**
+ * @brief Rebuilds the recovery table from the unused recovery keys.
+ */
+static void index_recovery_keys() {
+  memset(recovery_table, 0, sizeof(recovery_table));
+  if (!(keystore.flags & KEYSTORE_HAS_RECOVERY_KEYS)) {
+    return;
+  }
+  for (int slot = 0; slot < RECOVERY_KEY_COUNT; slot++) {
+    if (keystore.recovery_consumed & (1 << slot)) {
+      continue;
+    }
+    int bucket = hash_recovery_key(keystore.recovery_keys +
+                                   slot * RECOVERY_KEY_SIZE);
+    while (recovery_table[bucket]) {
+      bucket = (bucket + 1) & (RECOVERY_TABLE_SIZE - 1);
+    }
+    recovery_table[bucket] = slot + 1;
+  }
+}
+
+/**
+ * @brief Applies the consumption journal of the current recovery keys.
+ *
+ * Each journal entry is one byte holding the key epoch in the high nibble and
+ * the consumed slot in the low nibble. Entries left over from earlier keys
+ * carry a different epoch and are ignored.
+ */
+static void replay_recovery_journal() {
+  FILE *f = fopen(RECOVERY_JOURNAL_PATH, "rb");
   if (f) {
-    fgets(buf, PRIVATE_KEY_LENGTH + 1, f);
+    int entry;
+    while ((entry = getc(f)) != EOF) {
+      int slot = entry & 0x0F;
+      if ((entry >> 4) == (keystore.recovery_epoch & 0x0F) &&
+          slot < RECOVERY_KEY_COUNT) {
+        keystore.recovery_consumed |= 1 << slot;
+      }
+    }
     fclose(f);
-    return 0;
   }
-  return -1;
+  index_recovery_keys();
 }
 
-int get_recovery_keys(char *buf) {
-  FILE *f = fopen(RECOVERY_KEY_PATH, "r");
+/**
+ * @brief Atomically replaces the keystore record in memory.
+ *
+ * The record is written to a temporary file which is then renamed over the
+ * keystore, so a power loss never leaves a partially written record behind.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int save_keystore() {
+  keystore.magic = KEYSTORE_MAGIC;
+  keystore.version = KEYSTORE_VERSION;
+  keystore.crc = crc32(&keystore, offsetof(keystore_t, crc));
+
+  FILE *f = fopen(KEYSTORE_TEMP_PATH, "wb");
+  if (!f) {
+    printf("Cannot open file for write %s: %s\n", KEYSTORE_TEMP_PATH,
+           strerror(errno));
+    return -1;
+  }
+  size_t written = fwrite(&keystore, sizeof(keystore), 1, f);
+  fclose(f);
+  if (written != 1 || rename(KEYSTORE_TEMP_PATH, KEYSTORE_PATH) != 0) {
+    printf("Cannot write %s: %s\n", KEYSTORE_PATH, strerror(errno));
+    remove(KEYSTORE_TEMP_PATH);
+    return -1;
+  }
+  keystore_loaded = true;
+  return 0;
+}
+
+/**
+ * @brief Builds the keystore from the text files used by older firmware.
+ *
+ * @return 0 upon success, -1 if there is nothing to migrate.
+ */
+static int migrate_legacy_keys() {
+  memset(&keystore, 0, sizeof(keystore));
+
+  FILE *f = fopen(LEGACY_PRIVATE_KEY_PATH, "r");
   if (f) {
-    fgets(buf, RECOVERY_KEY_LENGTH + 1, f);
+    char hex[PRIVATE_KEY_LENGTH + 1] = {0};
+    fgets(hex, sizeof(hex), f);
     fclose(f);
-    return 0;
+    // A damaged key is dropped, so a new one is generated
+    if (hex_to_bytes(hex, PRIVATE_KEY_LENGTH, keystore.private_key,
+                     PRIVATE_KEY_SIZE) == PRIVATE_KEY_SIZE) {
+      keystore.flags |= KEYSTORE_HAS_PRIVATE_KEY;
+    }
   }
-  return -1;
-}
 
-int set_private_key(const char *key) {
-  FILE *f = fopen(PRIVATE_KEY_PATH, "w");
+  f = fopen(LEGACY_RECOVERY_KEY_PATH, "r");
   if (f) {
-    fprintf(f, "%*s", PRIVATE_KEY_LENGTH + 1, key);
+    char keys[RECOVERY_KEY_LENGTH + 1] = {0};
+    fgets(keys, sizeof(keys), f);
     fclose(f);
-    return 0;
+    memcpy(keystore.recovery_keys, keys, RECOVERY_KEY_LENGTH);
+    for (int slot = 0; slot < RECOVERY_KEY_COUNT; slot++) {
+      if (strncmp(keys + slot * RECOVERY_KEY_SIZE, "000000",
+                  RECOVERY_KEY_SIZE) == 0) {
+        keystore.recovery_consumed |= 1 << slot;
+      }
+    }
+    keystore.flags |= KEYSTORE_HAS_RECOVERY_KEYS;
+  }
+
+  if (!keystore.flags || save_keystore() != 0) {
+    return -1;
+  }
+  remove(LEGACY_PRIVATE_KEY_PATH);
+  remove(LEGACY_RECOVERY_KEY_PATH);
+  index_recovery_keys();
+  printf("> Migrated keys to keystore\n");
+  return 0;
+}
+
+int load_keystore() {
+  keystore_loaded = false;
+
+  FILE *f = fopen(KEYSTORE_PATH, "rb");
+  if (!f) {
+    return migrate_legacy_keys();
+  }
+  size_t read = fread(&keystore, sizeof(keystore), 1, f);
+  fclose(f);
+
+  if (read != 1 || keystore.magic != KEYSTORE_MAGIC ||
+      keystore.version != KEYSTORE_VERSION ||
+      keystore.crc != crc32(&keystore, offsetof(keystore_t, crc))) {
+    printf("Keystore is corrupt, discarding keys\n");
+    memset(&keystore, 0, sizeof(keystore));
+    return -1;
+  }
+  keystore_loaded = true;
+  replay_recovery_journal();
+  return 0;
+}
+
+int get_private_key(uint8_t *buf) {
+  TRACE_SCOPE(TRACE_KEY_FETCH, 0);
+  if (!keystore_loaded || !(keystore.flags & KEYSTORE_HAS_PRIVATE_KEY)) {
+    return -1;
+  }
+  memcpy(buf, keystore.private_key, PRIVATE_KEY_SIZE);
+  return 0;
+}
+
+int get_recovery_keys(char *buf) {
+  if (!keystore_loaded || !(keystore.flags & KEYSTORE_HAS_RECOVERY_KEYS)) {
+    return -1;
+  }
+  for (int slot = 0; slot < RECOVERY_KEY_COUNT; slot++) {
+    char *key = buf + slot * RECOVERY_KEY_SIZE;
+    if (keystore.recovery_consumed & (1 << slot)) {
+      memset(key, '0', RECOVERY_KEY_SIZE);
+    } else {
+      memcpy(key, keystore.recovery_keys + slot * RECOVERY_KEY_SIZE,
+             RECOVERY_KEY_SIZE);
+    }
+  }
+  buf[RECOVERY_KEY_LENGTH] = '\0';
+  return 0;
+}
+
+int set_private_key(const uint8_t *key) {
+  memcpy(keystore.private_key, key, PRIVATE_KEY_SIZE);
+  keystore.flags |= KEYSTORE_HAS_PRIVATE_KEY;
+  return save_keystore();
+}
+
+int set_recovery_keys(const char *keys) {
+  memcpy(keystore.recovery_keys, keys, RECOVERY_KEY_LENGTH);
+  keystore.recovery_consumed = 0;
+  keystore.recovery_epoch++;
+  keystore.flags |= KEYSTORE_HAS_RECOVERY_KEYS;
+  if (save_keystore() != 0) {
+    return -1;
+  }
+  remove(RECOVERY_JOURNAL_PATH);
+  index_recovery_keys();
+  return 0;
+}
+
+int count_recovery_keys() {
+  if (!keystore_loaded || !(keystore.flags & KEYSTORE_HAS_RECOVERY_KEYS)) {
+    return -1;
+  }
+  int count = 0;
+  for (int slot = 0; slot < RECOVERY_KEY_COUNT; slot++) {
+    if (!(keystore.recovery_consumed & (1 << slot))) {
+      count++;
+    }
+  }
+  return count;
+}
+
+int find_recovery_key(const char *code) {
+  int bucket = hash_recovery_key(code);
+  while (recovery_table[bucket]) {
+    int slot = recovery_table[bucket] - 1;
+    if (memcmp(keystore.recovery_keys + slot * RECOVERY_KEY_SIZE, code,
+               RECOVERY_KEY_SIZE) == 0) {
+      return slot;
+    }
+    bucket = (bucket + 1) & (RECOVERY_TABLE_SIZE - 1);
   }
-  printf("Cannot open file for write %s: %s\n", PRIVATE_KEY_PATH,
-         strerror(errno));
   return -1;
 }
 
-int set_recovery_keys(const char *key) {
-  FILE *f = fopen(RECOVERY_KEY_PATH, "w");
+int consume_recovery_key(int slot) {
+  if (slot < 0 || slot >= RECOVERY_KEY_COUNT) {
+    return -1;
+  }
+  keystore.recovery_consumed |= 1 << slot;
+  index_recovery_keys();
+
+  FILE *f = fopen(RECOVERY_JOURNAL_PATH, "ab");
+  if (!f) {
+    printf("Cannot open file for append %s: %s\n", RECOVERY_JOURNAL_PATH,
+           strerror(errno));
+    return -1;
+  }
+  int entry = (keystore.recovery_epoch & 0x0F) << 4 | slot;
+  int err = putc(entry, f);
+  fclose(f);
+  return err == EOF ? -1 : 0;
+}
+
+int get_lock_users(int lock, char (*users)[DEVICE_ADDRESS_LENGTH + 1],
+                   int max) {
+  FILE *f = fopen(LOCK_USERS_PATH, "r");
+  if (!f) {
+    return -1;
+  }
+  int count = 0;
+  int index;
+  char address[DEVICE_ADDRESS_LENGTH + 1];
+  while (count < max && fscanf(f, "%d %17s", &index, address) == 2) {
+    if (index == lock) {
+      strcpy(users[count++], address);
+    }
+  }
+  fclose(f);
+  return count;
+}
+
+/**
+ * @brief The queue that writes logs, NULL to write logs immediately.
+ */
+static EventQueue *log_queue = NULL;
+
+/**
+ * @brief Appends a timestamped log line to a file.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int append_log(const char *path, time_t seconds, const char *log) {
+  char formatted_time[20];
+  struct tm *timeinfo = localtime(&seconds);
+  strftime(formatted_time, sizeof(formatted_time), LOG_TIME_FORMAT, timeinfo);
+
+  FILE *f = fopen(path, "a");
   if (f) {
-    fprintf(f, "%*s", RECOVERY_KEY_LENGTH + 1, key);
+    fprintf(f, "[%s] %s\n", formatted_time, log);
     fclose(f);
     return 0;
   }
-  printf("Cannot open file for write %s: %s\n", RECOVERY_KEY_PATH,
-         strerror(errno));
+  printf("Cannot open file for append %s: %s\n", path, strerror(errno));
   return -1;
 }
 
+/**
+ * @brief Writes a deferred log entry.
+ */
+static void append_log_entry(log_entry_t entry) {
+  append_log(LOGS_PATH, entry.time, entry.message);
+}
+
+void set_log_queue(EventQueue *queue) { log_queue = queue; }
+
 int write_log(const char *log) {
+  TRACE_SCOPE(TRACE_WRITE_LOG, strlen(log));
   time_t seconds = time(NULL);
-  char *formatted_time = (char *)malloc(20);
-  struct tm *timeinfo = localtime(&seconds);
-  strftime(formatted_time, 20, "%m/%d/%y %H:%M:%S", timeinfo);
+  if (log_queue) {
+    log_entry_t entry;
+    entry.time = seconds;
+    strncpy(entry.message, log, sizeof(entry.message) - 1);
+    entry.message[sizeof(entry.message) - 1] = '\0';
+    if (log_queue->call(append_log_entry, entry)) {
+      return 0;
+    }
+    // Queue is full, fall back to writing in place
+  }
+  return append_log(LOGS_PATH, seconds, log);
+}
 
-  FILE *f = fopen(LOGS_PATH, "a");
-  if (f) {
-    fprintf(f, "[%s] %s\n", formatted_time, log);
-    fclose(f);
-    return 0;
+/**
+ * @brief Prints the time a benchmark step took and, with storage-profile,
+ * the flash time the QSPI cost model gives for its operations.
+ *
+ * @return Void.
+ */
+static void print_step_time(const char *step, const Timer &timer,
+                            uint64_t modeled_start_us) {
+  long long elapsed = duration_cast<microseconds>(timer.elapsed_time()).count();
+#if MBED_CONF_APP_STORAGE_PROFILE
+  printf("%s: %lld us (%" PRIu64 " us modeled flash)\n", step, elapsed,
+         profiled_bd.get_modeled_us() - modeled_start_us);
+#else
+  (void)modeled_start_us;
+  printf("%s: %lld us\n", step, elapsed);
+#endif
+}
+
+/**
+ * @brief Returns the modeled flash time so far.
+ *
+ * @return The modeled time in microseconds, 0 without storage-profile.
+ */
+static uint64_t modeled_flash_us() {
+#if MBED_CONF_APP_STORAGE_PROFILE
+  return profiled_bd.get_modeled_us();
+#else
+  return 0;
+#endif
+}
+
+void run_storage_benchmark() {
+  printf("=== Storage Benchmark ===\n");
+  printf("read %d, prog %d, block %d, lookahead %d\n",
+         MBED_CONF_APP_LFS_READ_SIZE, MBED_CONF_APP_LFS_PROG_SIZE,
+         MBED_CONF_APP_LFS_BLOCK_SIZE, MBED_CONF_APP_LFS_LOOKAHEAD);
+
+  // LittleFS v1 holds a read cache and a program cache per file system, a
+  // program cache per open file and one lookahead bit per block
+  int ram = MBED_CONF_APP_LFS_READ_SIZE + 2 * MBED_CONF_APP_LFS_PROG_SIZE +
+            MBED_CONF_APP_LFS_LOOKAHEAD / 8;
+  printf("File system buffers: %d bytes\n", ram);
+
+  Timer timer;
+  fs.unmount();
+  uint64_t modeled = modeled_flash_us();
+  timer.start();
+  mount_fs();
+  print_step_time("Mount", timer, modeled);
+
+  remove(BENCHMARK_LOGS_PATH);
+  modeled = modeled_flash_us();
+  timer.reset();
+  for (int i = 0; i < MBED_CONF_APP_STORAGE_BENCHMARK_APPENDS; i++) {
+    if (append_log(BENCHMARK_LOGS_PATH, time(NULL), BENCHMARK_LOG_MESSAGE)) {
+      break;
+    }
+  }
+  long long elapsed = duration_cast<microseconds>(timer.elapsed_time()).count();
+  printf("%d log appends: %lld us (%lld appends/s)\n",
+         MBED_CONF_APP_STORAGE_BENCHMARK_APPENDS, elapsed,
+         elapsed ? MBED_CONF_APP_STORAGE_BENCHMARK_APPENDS * 1000000LL / elapsed
+                 : 0);
+  print_step_time("Log appends", timer, modeled);
+  remove(BENCHMARK_LOGS_PATH);
+
+  uint8_t key[PRIVATE_KEY_SIZE];
+  modeled = modeled_flash_us();
+  timer.reset();
+  for (int i = 0; i < 100; i++) {
+    load_keystore();
+    get_private_key(key);
   }
-  printf("Cannot open file for append %s: %s\n", LOGS_PATH, strerror(errno));
+  print_step_time("100 keystore loads", timer, modeled);
+
+  print_storage_stats();
+  printf("=== Benchmark End ===\n");
+}
+
+int print_storage_stats() {
+#if MBED_CONF_APP_STORAGE_PROFILE
+  profiled_bd.print_stats();
+  return 0;
+#else
   return -1;
+#endif
+}
+
+FILE *open_logs() {
+  FILE *f = fopen(LOGS_PATH, "r");
+  if (!f) {
+    printf("Cannot open file for read %s: %s\n", LOGS_PATH, strerror(errno));
+  }
+  return f;
+}
+
+int read_log_record(FILE *f, char *buf, int size) {
+  if (!fgets(buf, size, f)) {
+    return 0;
+  }
+  return strlen(buf);
+}
+
+/**
+ * @brief Categorizes a log message by its wording.
+ *
+ * @return The log_event_t of the message.
+ */
+static log_event_t classify_log(const char *message) {
+  if (strncmp(message, "Received valid", 14) == 0) {
+    return LOG_EVENT_UNLOCK;
+  }
+  if (strncmp(message, "Received invalid", 16) == 0) {
+    return LOG_EVENT_REJECTED;
+  }
+  if (strncmp(message, "Device ", 7) == 0 && strstr(message, "connected")) {
+    return LOG_EVENT_CONNECTION;
+  }
+  if (strncmp(message, "+ Device booted", 15) == 0 ||
+      strncmp(message, "Using stored", 12) == 0 ||
+      strncmp(message, "Generated new", 13) == 0) {
+    return LOG_EVENT_BOOT;
+  }
+  return LOG_EVENT_OTHER;
+}
+
+int log_record_matches(const char *record, const log_filter_t *filter) {
+  struct tm timeinfo = {0};
+  int consumed = 0;
+  if (sscanf(record, "[%d/%d/%d %d:%d:%d] %n", &timeinfo.tm_mon,
+             &timeinfo.tm_mday, &timeinfo.tm_year, &timeinfo.tm_hour,
+             &timeinfo.tm_min, &timeinfo.tm_sec, &consumed) != 6 ||
+      consumed == 0) {
+    return 0;
+  }
+  timeinfo.tm_mon -= 1;
+  timeinfo.tm_year += 100;
+  time_t timestamp = mktime(&timeinfo);
+
+  if ((filter->from && timestamp < filter->from) ||
+      (filter->to && timestamp > filter->to)) {
+    return 0;
+  }
+  const char *message = record + consumed;
+  if (filter->events && !(filter->events & classify_log(message))) {
+    return 0;
+  }
+  if (filter->device[0] && !strstr(message, filter->device)) {
+    return 0;
+  }
+  return 1;
+}
+
+int redact_log_record(char *record) {
+  // Older records read "Received <kind> code: <code> from <device>..."
+  char *code = strstr(record, " code: ");
+  if (code) {
+    char *rest = strstr(code + 7, " from ");
+    if (rest) {
+      memmove(code + 5, rest, strlen(rest) + 1);
+    }
+  }
+  return strlen(record);
 }
 
 int print_logs() {
@@ -11,24 +11,47 @@
 #ifndef DATASTORE_H
 #define DATASTORE_H
 
+#include "HeapBlockDevice.h"
 #include "LittleFileSystem.h"
+#include "codec.hpp"
+#include "helpers.hpp"
+#include "instrumented_block_device.hpp"
 #include "keys.hpp"
+#include "trace.hpp"
 #include "mbed.h"
 #include <errno.h>
 #include <functional>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Target board has QSPI Flash
-#if !(COMPONENT_QSPIF)
+// Target board has QSPI Flash, unless the heap simulator is selected
+#if !(COMPONENT_QSPIF) && !MBED_CONF_APP_STORAGE_SIM
 #error[ERROR] Storage unavailable.
 #endif
 
-#define PRIVATE_KEY_PATH "/fs/private_key.txt"
-#define RECOVERY_KEY_PATH "/fs/recovery_key.txt"
+#define KEYSTORE_PATH "/fs/keystore.bin"
+#define KEYSTORE_TEMP_PATH "/fs/keystore.tmp"
+#define RECOVERY_JOURNAL_PATH "/fs/recovery_used.bin"
+#define LEGACY_PRIVATE_KEY_PATH "/fs/private_key.txt"
+#define LEGACY_RECOVERY_KEY_PATH "/fs/recovery_key.txt"
 #define LOGS_PATH "/fs/logs.txt"
+#define LOCK_USERS_PATH "/fs/lock_users.txt"
+#define BENCHMARK_LOGS_PATH "/fs/bench_logs.txt"
+// A typical log record, written by the storage benchmarks
+#define BENCHMARK_LOG_MESSAGE                                                  \
+  "Received valid TOTP code from 00:00:00:00:00:00 on lock 0"
+#define BOOT_PROFILE_PATH "/fs/boot.bin"
+#define RTC_MODEL_PATH "/fs/rtc.bin"
+#define WIFI_CACHE_PATH "/fs/wifi.bin"
+#define BLE_SECURITY_DB_PATH "/fs/ble_bonds.bin"
 #define BUFFER_MAX_LEN 10
+#define LOG_TIME_FORMAT "%m/%d/%y %H:%M:%S"
+#define LOG_MESSAGE_MAX_LEN 80
+#define DEVICE_ADDRESS_LENGTH 17
+#define ERASE_SCAN_BUFFER_SIZE 256
+#define ERASE_RECORD_MAGIC 0x4552 // "ER"
 
 /**
  * @brief Mounts and initializes the file system.
@@ -36,24 +59,65 @@
  */
 int mount_fs();
 
+enum erase_mode_t {
+  ERASE_QUICK, // Erase only the blocks that hold data
+  ERASE_DEEP   // Erase the entire block device
+};
+
 /**
  * @brief Erases the file system.
- * @return 0 upon success, -1 on error / failure.
+ *
+ * A quick erase reads every block and erases only those that are not blank,
+ * which wipes the superblock, the keystore and the logs without paying for
+ * erasing the unused part of the flash.
+ *
+ * @param mode The erase mode.
+ * @return Void.
  */
-void erase_fs();
+void erase_fs(erase_mode_t mode);
 
 /**
- * @brief Get the private key from memory.
+ * @brief An erase that ran right before the reset that started this boot.
+ */
+typedef struct {
+  erase_mode_t mode;
+  uint32_t ms;
+} erase_record_t;
+
+/**
+ * @brief Takes the record of the erase that ran before the reset that started
+ * this boot. The erase wipes the file system, so the record is kept in the
+ * RTC backup registers, which survive a reset but not a power cycle. The
+ * record is cleared once taken.
  *
- * @param buf Buffer to store the private key.
+ * @param record The record to fill.
+ * @return 0 upon success, -1 if this boot did not follow an erase.
+ */
+int take_erase_record(erase_record_t *record);
+
+/**
+ * @brief Loads the keystore record from memory in a single read.
+ *
+ * Keys stored by older firmware in separate text files are migrated into the
+ * keystore the first time it is loaded.
+ *
+ * @return 0 upon success, -1 if no valid keystore exists.
+ */
+int load_keystore();
+
+/**
+ * @brief Get the private key from the loaded keystore.
+ *
+ * @param buf Buffer of PRIVATE_KEY_SIZE bytes to store the raw private key.
  * @return 0 upon success, -1 on error / failure.
  */
-int get_private_key(char *buf);
+int get_private_key(uint8_t *buf);
 
 /**
- * @brief Get the reset keys from memory.
+ * @brief Get the recovery keys from the loaded keystore. Consumed keys are
+ * returned as "000000".
  *
- * @param buf Buffer to store the reset key.
+ * @param buf Buffer of RECOVERY_KEY_LENGTH + 1 characters to store the keys.
  * @return 0 upon success, -1 on error / failure.
  */
 int get_recovery_keys(char *buf);
@@ -61,27 +125,151 @@ int get_recovery_keys(char *buf);
 /**
  * @brief Sets the private key in memory.
  *
- * @param key The key string to write.
+ * @param key The PRIVATE_KEY_SIZE raw key bytes to write.
+ * @return 0 upon success, -1 on error / failure.
+ */
+int set_private_key(const uint8_t *key);
+
+/**
+ * @brief Sets the recovery keys in memory and marks them all as unused.
+ *
+ * @param keys The RECOVERY_KEY_LENGTH character key string to write.
  * @return 0 upon success, -1 on error / failure.
  */
-int set_private_key(const char *key);
+int set_recovery_keys(const char *keys);
 
 /**
- * @brief Sets the reset keys in memory.
+ * @brief Counts the recovery keys that have not been consumed.
  *
- * @param key The key string to write.
+ * @return The number of unused keys, -1 if no recovery keys are stored.
+ */
+int count_recovery_keys();
+
+/**
+ * @brief Finds the slot of an unused recovery key.
+ *
+ * @param code The RECOVERY_KEY_SIZE character code to look up.
+ * @return The slot of the matching key, -1 if no unused key matches.
+ */
+int find_recovery_key(const char *code);
+
+/**
+ * @brief Marks a recovery key as consumed in memory. This appends a single
+ * byte to the consumption journal instead of rewriting the keystore.
+ *
+ * @param slot The index of the recovery key.
  * @return 0 upon success, -1 on error / failure.
  */
-int set_recovery_keys(const char *key);
+int consume_recovery_key(int slot);
 
 /**
- * @brief Writes a timestamped log to the log file.
+ * @brief Get the devices authorized to open a lock. Each line of the lock
+ * users file holds a lock index and a device address.
+ *
+ * @param lock The index of the lock.
+ * @param users Buffer to store the device addresses.
+ * @param max The number of addresses the buffer holds.
+ * @return The number of addresses, -1 if there is no lock users file.
+ */
+int get_lock_users(int lock, char (*users)[DEVICE_ADDRESS_LENGTH + 1],
+                   int max);
+
+/**
+ * @brief A log message waiting to be written.
+ */
+typedef struct {
+  time_t time;
+  char message[LOG_MESSAGE_MAX_LEN];
+} log_entry_t;
+
+/**
+ * @brief Defers log writes to a queue, so callers do not wait on the flash.
+ *
+ * @param queue The queue that writes logs, NULL to write logs immediately.
+ * @return Void.
+ */
+void set_log_queue(events::EventQueue *queue);
+
+/**
+ * @brief Writes a timestamped log to the log file. The timestamp is taken
+ * when this is called, even when the write itself is deferred.
  *
  * @param log The log message.
  * @return 0 upon success, -1 on error / failure.
  */
 int write_log(const char *log);
 
+/**
+ * @brief Times a remount, a run of log appends and keystore loads using the
+ * configured LittleFS geometry, then prints the results.
+ * @return Void.
+ */
+void run_storage_benchmark();
+
+/**
+ * @brief Prints the block device operation counters, modeled flash time and
+ * wear histogram. Requires the storage-profile option.
+ * @return 0 upon success, -1 if profiling is disabled.
+ */
+int print_storage_stats();
+
+/**
+ * @brief Categories of log records, used as a bitmask by log filters.
+ */
+enum log_event_t {
+  LOG_EVENT_BOOT = 1 << 0,       // Device boots and key setup
+  LOG_EVENT_CONNECTION = 1 << 1, // BLE connections and disconnections
+  LOG_EVENT_UNLOCK = 1 << 2,     // Valid codes that unlocked the lock
+  LOG_EVENT_REJECTED = 1 << 3,   // Invalid codes
+  LOG_EVENT_OTHER = 1 << 4       // Everything else
+};
+
+/**
+ * @brief Selects log records by time, category and device.
+ */
+typedef struct {
+  time_t from;                            // Earliest time, 0 for unbounded
+  time_t to;                              // Latest time, 0 for unbounded
+  uint8_t events;                         // log_event_t mask, 0 for all
+  char device[DEVICE_ADDRESS_LENGTH + 1]; // Device address, "" for any
+} log_filter_t;
+
+/**
+ * @brief Checks whether a log record satisfies a filter.
+ *
+ * @param record The log record as read by read_log_record().
+ * @param filter The filter to apply.
+ * @return 1 if the record matches, 0 otherwise.
+ */
+int log_record_matches(const char *record, const log_filter_t *filter);
+
+/**
+ * @brief Removes the code from a record written by older firmware, which
+ * logged the codes it received, so that records can be shared.
+ *
+ * @param record The log record as read by read_log_record(), changed in
+ * place.
+ * @return The new length of the record.
+ */
+int redact_log_record(char *record);
+
+/**
+ * @brief Opens the log file for reading.
+ * @return The open file, NULL on error / failure.
+ */
+FILE *open_logs();
+
+/**
+ * @brief Reads the next log record, including its newline, from an open log
+ * file. Records longer than the buffer are returned in several parts.
+ *
+ * @param f The open log file.
+ * @param buf Buffer to store the record.
+ * @param size The size of the buffer.
+ * @return The length of the record, 0 at the end of the log.
+ */
+int read_log_record(FILE *f, char *buf, int size);
+
 /**
  * @brief Prints the entire log file to stdout.
  * @return 0 upon success, -1 on error / failure.
@@ -0,0 +1,41 @@
+/**
+ * @file drive_profile.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains the drive profiles of lock actuators and the
+ * waveform they produce.
+ * @bug No known bugs.
+ */
+#include "drive_profile.hpp"
+
+const drive_profile_t DRIVE_PROFILES[] = {
+    // DRIVE_FULL_POWER
+    {1.0f, 0, 1.0f, 0, 1000},
+    // DRIVE_SOLENOID: 150 ms pull-in, 35% hold until the lock closes
+    {1.0f, 150, 0.35f, 0, 50},
+    // DRIVE_STRIKE: 200 ms pull-in, 50% hold, released after 3 s
+    {1.0f, 200, 0.5f, 3000, 50},
+};
+
+float drive_level_at(const drive_profile_t *profile, uint32_t elapsed_ms) {
+  if (profile->release_ms && elapsed_ms >= profile->release_ms) {
+    return 0.0f;
+  }
+  if (elapsed_ms < profile->pull_in_ms) {
+    return profile->pull_in_level;
+  }
+  return profile->hold_level;
+}
+
+int32_t drive_next_change(const drive_profile_t *profile, uint32_t elapsed_ms) {
+  if (elapsed_ms < profile->pull_in_ms &&
+      (!profile->release_ms || profile->pull_in_ms < profile->release_ms)) {
+    return profile->pull_in_ms;
+  }
+  if (profile->release_ms && elapsed_ms < profile->release_ms) {
+    return profile->release_ms;
+  }
+  return -1;
+}
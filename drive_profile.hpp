@@ -0,0 +1,63 @@
+/**
+ * @file drive_profile.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines the drive profiles of lock actuators and the
+ * waveform they produce.
+ * @bug No known bugs.
+ */
+#ifndef DRIVE_PROFILE_H
+#define DRIVE_PROFILE_H
+
+#include <stdint.h>
+
+/**
+ * @brief How an actuator is driven while the lock is open.
+ *
+ * The output starts with a pull-in pulse, drops to the hold level and is
+ * released once the release time has passed, even if the lock is still open.
+ * The lock counts as closed again once its output is released.
+ */
+typedef struct {
+  float pull_in_level;    // Output level of the pull-in pulse, 0.0 to 1.0
+  uint16_t pull_in_ms;    // Length of the pull-in pulse
+  float hold_level;       // Output level after the pull-in pulse
+  uint32_t release_ms;    // Time until the output is released, 0 for never
+  uint16_t pwm_period_us; // PWM period used on pins without a DAC
+} drive_profile_t;
+
+/**
+ * @brief The drive profiles of the supported lock types, indices into
+ * DRIVE_PROFILES.
+ */
+enum drive_profile_id_t {
+  DRIVE_FULL_POWER, // Logic level output held high, as on pin D7
+  DRIVE_SOLENOID,   // Solenoid bolt, held at reduced current while open
+  DRIVE_STRIKE      // Electric strike, briefly pulsed then released
+};
+
+extern const drive_profile_t DRIVE_PROFILES[];
+
+/**
+ * @brief Returns the output level of a profile some time after the actuator
+ * was energized.
+ *
+ * @param profile The drive profile.
+ * @param elapsed_ms The time since the actuator was energized.
+ * @return The output level, 0.0 to 1.0.
+ */
+float drive_level_at(const drive_profile_t *profile, uint32_t elapsed_ms);
+
+/**
+ * @brief Returns when the output level of a profile next changes.
+ *
+ * @param profile The drive profile.
+ * @param elapsed_ms The time since the actuator was energized.
+ * @return The time of the next change since the actuator was energized, -1 if
+ * the level no longer changes.
+ */
+int32_t drive_next_change(const drive_profile_t *profile, uint32_t elapsed_ms);
+
+#endif // DRIVE_PROFILE_H
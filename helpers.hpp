@@ -10,7 +10,10 @@
 #ifndef HELPERS_H
 #define HELPERS_H
 
+#include "keys.hpp"
 #include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /**
  * @brief Convert a string to uppercase.
@@ -20,4 +23,34 @@
  */
 char *strupr(char *str);
 
+/**
+ * @brief Compute the standard CRC-32 (IEEE 802.3) of a buffer.
+ *
+ * @param data The buffer to checksum.
+ * @param length The number of bytes in the buffer.
+ * @return The CRC-32 of the buffer.
+ */
+uint32_t crc32(const void *data, size_t length);
+
+/**
+ * @brief Continue a CRC-32 over more data, for data that arrives in pieces.
+ * Start from 0xFFFFFFFF and invert the final value.
+ *
+ * @param crc The CRC so far.
+ * @param data The buffer to checksum.
+ * @param length The number of bytes in the buffer.
+ * @return The updated CRC.
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length);
+
+/**
+ * @brief Turn random bytes into the recovery keys, one uppercase letter per
+ * byte.
+ *
+ * @param random RECOVERY_KEY_LENGTH random bytes.
+ * @param keys The buffer to write the keys to, RECOVERY_KEY_LENGTH + 1 bytes.
+ * @return Void.
+ */
+void format_recovery_keys(const uint8_t *random, char *keys);
+
 #endif // HELPERS_H
@@ -0,0 +1,169 @@
+/**
+ * @file instrumented_block_device.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains a block device that counts the operations issued
+ * to another block device and models their cost on QSPI flash.
+ * @bug No known bugs.
+ */
+#include "instrumented_block_device.hpp"
+
+const flash_timing_t InstrumentedBlockDevice::default_timing = {
+    1000,     // 1 us command overhead
+    20,       // 50 MB/s quad read
+    850000,   // 0.85 ms page program
+    40000000, // 40 ms 4 KB sector erase
+    256,      // 256 byte pages
+};
+
+InstrumentedBlockDevice::InstrumentedBlockDevice(mbed::BlockDevice *bd,
+                                                 const flash_timing_t &timing)
+    : _bd(bd), _timing(timing), _blocks(NULL), _block_count(0),
+      _block_size(0) {
+  reset_stats();
+}
+
+InstrumentedBlockDevice::~InstrumentedBlockDevice() { delete[] _blocks; }
+
+int InstrumentedBlockDevice::init() {
+  int err = _bd->init();
+  if (err || _blocks) {
+    return err;
+  }
+
+  _block_size = _bd->get_erase_size();
+  _block_count = _bd->size() / _block_size;
+  _blocks = new block_stats_t[_block_count];
+  memset(_blocks, 0, _block_count * sizeof(block_stats_t));
+  return 0;
+}
+
+int InstrumentedBlockDevice::deinit() { return _bd->deinit(); }
+
+int InstrumentedBlockDevice::sync() { return _bd->sync(); }
+
+int InstrumentedBlockDevice::read(void *buffer, bd_addr_t addr,
+                                  bd_size_t size) {
+  _count(&block_stats_t::reads, addr, size);
+  _bytes_read += size;
+  _modeled_ns += _timing.command_ns + size * _timing.read_byte_ns;
+  return _bd->read(buffer, addr, size);
+}
+
+int InstrumentedBlockDevice::program(const void *buffer, bd_addr_t addr,
+                                     bd_size_t size) {
+  _count(&block_stats_t::programs, addr, size);
+  _bytes_programmed += size;
+  bd_size_t pages = (size + _timing.page_size - 1) / _timing.page_size;
+  _modeled_ns += pages * (_timing.command_ns + _timing.program_page_ns);
+  return _bd->program(buffer, addr, size);
+}
+
+int InstrumentedBlockDevice::erase(bd_addr_t addr, bd_size_t size) {
+  _count(&block_stats_t::erases, addr, size);
+  _bytes_erased += size;
+  bd_size_t blocks = _block_size ? size / _block_size : 0;
+  _modeled_ns += blocks * (_timing.command_ns + _timing.erase_block_ns);
+  return _bd->erase(addr, size);
+}
+
+int InstrumentedBlockDevice::trim(bd_addr_t addr, bd_size_t size) {
+  return _bd->trim(addr, size);
+}
+
+bd_size_t InstrumentedBlockDevice::get_read_size() const {
+  return _bd->get_read_size();
+}
+
+bd_size_t InstrumentedBlockDevice::get_program_size() const {
+  return _bd->get_program_size();
+}
+
+bd_size_t InstrumentedBlockDevice::get_erase_size() const {
+  return _bd->get_erase_size();
+}
+
+bd_size_t InstrumentedBlockDevice::get_erase_size(bd_addr_t addr) const {
+  return _bd->get_erase_size(addr);
+}
+
+int InstrumentedBlockDevice::get_erase_value() const {
+  return _bd->get_erase_value();
+}
+
+bd_size_t InstrumentedBlockDevice::size() const { return _bd->size(); }
+
+const char *InstrumentedBlockDevice::get_type() const {
+  return _bd->get_type();
+}
+
+void InstrumentedBlockDevice::reset_stats() {
+  _bytes_read = 0;
+  _bytes_programmed = 0;
+  _bytes_erased = 0;
+  _modeled_ns = 0;
+  if (_blocks) {
+    memset(_blocks, 0, _block_count * sizeof(block_stats_t));
+  }
+}
+
+uint64_t InstrumentedBlockDevice::get_modeled_us() const {
+  return _modeled_ns / 1000;
+}
+
+void InstrumentedBlockDevice::print_stats() const {
+  uint32_t reads = 0, programs = 0, erases = 0;
+  uint32_t histogram[WEAR_HISTOGRAM_BUCKETS] = {0};
+  uint16_t max_erases = 0;
+
+  for (bd_size_t i = 0; i < _block_count; i++) {
+    reads += _blocks[i].reads;
+    programs += _blocks[i].programs;
+    erases += _blocks[i].erases;
+    if (_blocks[i].erases > max_erases) {
+      max_erases = _blocks[i].erases;
+    }
+
+    // Bucket 0 holds unerased blocks, bucket n holds [2^(n-1), 2^n)
+    int bucket = 0;
+    for (uint16_t count = _blocks[i].erases; count; count >>= 1) {
+      bucket++;
+    }
+    if (bucket >= WEAR_HISTOGRAM_BUCKETS) {
+      bucket = WEAR_HISTOGRAM_BUCKETS - 1;
+    }
+    histogram[bucket]++;
+  }
+
+  printf("=== Storage Stats (%s) ===\n", get_type());
+  printf("Reads: %" PRIu32 " (%" PRIu64 " bytes)\n", reads, _bytes_read);
+  printf("Programs: %" PRIu32 " (%" PRIu64 " bytes)\n", programs,
+         _bytes_programmed);
+  printf("Erases: %" PRIu32 " (%" PRIu64 " bytes)\n", erases, _bytes_erased);
+  printf("Modeled flash time: %" PRIu64 " us\n", get_modeled_us());
+  printf("Erases per block (max %u):\n", max_erases);
+  for (int bucket = 0; bucket < WEAR_HISTOGRAM_BUCKETS; bucket++) {
+    if (histogram[bucket]) {
+      printf("  %5u-%-5u %" PRIu32 " blocks\n",
+             bucket ? 1u << (bucket - 1) : 0,
+             bucket ? (1u << bucket) - 1 : 0, histogram[bucket]);
+    }
+  }
+  printf("=== Stats End ===\n");
+}
+
+void InstrumentedBlockDevice::_count(uint16_t block_stats_t::*counter,
+                                     bd_addr_t addr, bd_size_t size) {
+  if (!_blocks || !size) {
+    return;
+  }
+  bd_size_t first = addr / _block_size;
+  bd_size_t last = (addr + size - 1) / _block_size;
+  for (bd_size_t i = first; i <= last && i < _block_count; i++) {
+    if (_blocks[i].*counter != UINT16_MAX) {
+      _blocks[i].*counter += 1;
+    }
+  }
+}
@@ -0,0 +1,114 @@
+/**
+ * @file instrumented_block_device.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines a block device that counts the operations issued
+ * to another block device and models their cost on QSPI flash.
+ * @bug No known bugs.
+ */
+#ifndef INSTRUMENTED_BLOCK_DEVICE_H
+#define INSTRUMENTED_BLOCK_DEVICE_H
+
+#include "BlockDevice.h"
+#include "mbed.h"
+
+#define WEAR_HISTOGRAM_BUCKETS 12
+
+/**
+ * @brief Typical operation timings of the QSPI flash, in nanoseconds.
+ *
+ * Defaults follow the MX25R6435F fitted to the DISCO-L475VG-IOT01A.
+ */
+struct flash_timing_t {
+  uint32_t command_ns;      // Fixed cost of issuing any command
+  uint32_t read_byte_ns;    // Cost of transferring one byte on a read
+  uint32_t program_page_ns; // Cost of programming one page
+  uint32_t erase_block_ns;  // Cost of erasing one erase block
+  uint32_t page_size;       // Size of a program page in bytes
+};
+
+/**
+ * @brief Operation counters of one erase block.
+ */
+struct block_stats_t {
+  uint16_t reads;
+  uint16_t programs;
+  uint16_t erases;
+};
+
+class InstrumentedBlockDevice : public mbed::BlockDevice {
+public:
+  /**
+   * @brief Construct a new InstrumentedBlockDevice object.
+   *
+   * @param bd The block device to forward operations to.
+   * @param timing The flash timings used to model operation cost.
+   * @return Instance of InstrumentedBlockDevice.
+   */
+  InstrumentedBlockDevice(mbed::BlockDevice *bd,
+                          const flash_timing_t &timing = default_timing);
+
+  virtual ~InstrumentedBlockDevice();
+
+  virtual int init();
+  virtual int deinit();
+  virtual int sync();
+  virtual int read(void *buffer, bd_addr_t addr, bd_size_t size);
+  virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size);
+  virtual int erase(bd_addr_t addr, bd_size_t size);
+  virtual int trim(bd_addr_t addr, bd_size_t size);
+  virtual bd_size_t get_read_size() const;
+  virtual bd_size_t get_program_size() const;
+  virtual bd_size_t get_erase_size() const;
+  virtual bd_size_t get_erase_size(bd_addr_t addr) const;
+  virtual int get_erase_value() const;
+  virtual bd_size_t size() const;
+  virtual const char *get_type() const;
+
+  /**
+   * @brief Clears all counters and the modeled time.
+   *
+   * @return Void.
+   */
+  void reset_stats();
+
+  /**
+   * @brief Returns the modeled time spent in flash operations.
+   *
+   * @return The modeled time in microseconds.
+   */
+  uint64_t get_modeled_us() const;
+
+  /**
+   * @brief Prints the operation totals, the modeled cost and a histogram of
+   * erase counts per block.
+   *
+   * @return Void.
+   */
+  void print_stats() const;
+
+  static const flash_timing_t default_timing;
+
+private:
+  mbed::BlockDevice *_bd;
+  flash_timing_t _timing;
+  block_stats_t *_blocks;
+  bd_size_t _block_count;
+  bd_size_t _block_size;
+  uint64_t _bytes_read;
+  uint64_t _bytes_programmed;
+  uint64_t _bytes_erased;
+  uint64_t _modeled_ns;
+
+  /**
+   * @brief Adds one to a counter of every block touched by an operation.
+   *
+   * @return Void.
+   */
+  void _count(uint16_t block_stats_t::*counter, bd_addr_t addr,
+              bd_size_t size);
+};
+
+#endif // INSTRUMENTED_BLOCK_DEVICE_H
@@ -4,13 +4,58 @@
  * @author Philip Cai (Gadnalf)
  * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
  *
- * @brief This header defines the lengths of the keys.
+ * @brief This header defines the lengths of the keys and the layout of the
+ * keystore record.
  * @bug No known bugs.
  */
 #ifndef KEYS_H
 #define KEYS_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #define PRIVATE_KEY_LENGTH 20
+#define PRIVATE_KEY_SIZE 10
 #define RECOVERY_KEY_LENGTH 36
+#define RECOVERY_KEY_SIZE 6
+#define RECOVERY_KEY_COUNT 6
+
+// The URI shown as the enrollment QR code, given the base32 private key
+#define OTPAUTH_URI_FORMAT "otpauth://totp/SmartLock?secret=%s"
+// The enrollment URI of lock 1 onwards, given its index and base32 secret
+#define OTPAUTH_LOCK_URI_FORMAT "otpauth://totp/SmartLock-%d?secret=%s"
+
+#define KEYSTORE_MAGIC 0x4B4C4D53 // "SMLK"
+#define KEYSTORE_VERSION 1
+
+#define KEYSTORE_HAS_PRIVATE_KEY 0x01
+#define KEYSTORE_HAS_RECOVERY_KEYS 0x02
+
+/**
+ * @brief The keystore record as it is stored in flash.
+ *
+ * The record is read and written as a whole. Padding is zeroed before the CRC
+ * is computed, so the CRC covers every byte preceding the crc field.
+ *
+ * recovery_epoch was added to version 1 in what used to be padding, which
+ * older firmware left zeroed, so older records read as epoch 0. Fields may
+ * only be added this way while the layout below holds; anything else needs
+ * a new KEYSTORE_VERSION.
+ */
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t flags;
+  uint8_t recovery_consumed; // Bit n is set once recovery key n was used
+  uint8_t private_key[PRIVATE_KEY_SIZE];
+  char recovery_keys[RECOVERY_KEY_LENGTH];
+  uint8_t recovery_epoch; // Tags the consumption journal of these keys
+  uint32_t crc;
+} keystore_t;
+
+static_assert(offsetof(keystore_t, recovery_epoch) == 54,
+              "recovery_epoch must stay in the padding of version 1");
+static_assert(offsetof(keystore_t, crc) == 56 && sizeof(keystore_t) == 60,
+              "keystore_t must keep the version 1 layout");
 
 #endif // KEYS_H
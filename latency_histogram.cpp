@@ -0,0 +1,48 @@
+/**
+ * @file latency_histogram.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains fixed bucket histograms for latency samples.
+ * @bug No known bugs.
+ */
+#include "latency_histogram.hpp"
+#include <inttypes.h>
+#include <stdio.h>
+
+void latency_record(latency_histogram_t *histogram, uint32_t us) {
+  int bucket = 0;
+  for (uint32_t value = us >> 1; value && bucket < LATENCY_BUCKETS - 1;
+       value >>= 1) {
+    bucket++;
+  }
+  histogram->counts[bucket]++;
+  histogram->samples++;
+  histogram->total_us += us;
+  if (us > histogram->max_us) {
+    histogram->max_us = us;
+  }
+}
+
+void latency_print(const latency_histogram_t *histogram, const char *name) {
+  printf("%s: %" PRIu32 " samples", name, histogram->samples);
+  if (histogram->samples) {
+    printf(", mean %" PRIu32 " us, max %" PRIu32 " us",
+           (uint32_t)(histogram->total_us / histogram->samples),
+           histogram->max_us);
+  }
+  printf("\n");
+  for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+    if (!histogram->counts[bucket]) {
+      continue;
+    }
+    if (bucket == LATENCY_BUCKETS - 1) {
+      printf(" >= %8" PRIu32 " us: %" PRIu32 "\n", (uint32_t)1 << bucket,
+             histogram->counts[bucket]);
+    } else {
+      printf("  < %8" PRIu32 " us: %" PRIu32 "\n", (uint32_t)2 << bucket,
+             histogram->counts[bucket]);
+    }
+  }
+}
@@ -0,0 +1,47 @@
+/**
+ * @file latency_histogram.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines fixed bucket histograms for latency samples.
+ * @bug No known bugs.
+ */
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+
+// Bucket 0 holds samples below 2 us, bucket n holds [2^n, 2^(n+1)) us and the
+// last bucket holds everything above
+#define LATENCY_BUCKETS 24
+
+/**
+ * @brief A histogram of latency samples with power of two buckets.
+ */
+typedef struct {
+  uint32_t counts[LATENCY_BUCKETS];
+  uint32_t samples;
+  uint32_t max_us;
+  uint64_t total_us;
+} latency_histogram_t;
+
+/**
+ * @brief Adds a sample to a histogram.
+ *
+ * @param histogram The histogram.
+ * @param us The latency in microseconds.
+ * @return Void.
+ */
+void latency_record(latency_histogram_t *histogram, uint32_t us);
+
+/**
+ * @brief Prints the non-empty buckets, mean and maximum of a histogram.
+ *
+ * @param histogram The histogram.
+ * @param name The name printed above the histogram.
+ * @return Void.
+ */
+void latency_print(const latency_histogram_t *histogram, const char *name);
+
+#endif // LATENCY_HISTOGRAM_H
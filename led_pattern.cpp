@@ -0,0 +1,50 @@
+/**
+ * @file led_pattern.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains a non-blocking engine for LED blink patterns.
+ * @bug No known bugs.
+ */
+#include "led_pattern.hpp"
+
+static queue_site_t led_pattern_site = QUEUE_SITE("led pattern");
+
+LedPattern::LedPattern(ProfiledEventQueue *event_queue, PinName led1,
+                       PinName led2)
+    : _event_queue(event_queue), _led1(led1), _led2(led2), _steps(NULL),
+      _count(0), _index(0), _event_id(0) {}
+
+void LedPattern::play(const led_step_t *steps, int count) {
+  if (_event_id) {
+    _event_queue->cancel(_event_id);
+    _event_id = 0;
+  }
+  _steps = steps;
+  _count = count;
+  _index = 0;
+  _step();
+}
+
+void LedPattern::_step() {
+  _event_id = 0;
+  if (_index >= _count) {
+    _write(_led1, 0);
+    _write(_led2, 0);
+    return;
+  }
+
+  const led_step_t &step = _steps[_index++];
+  _write(_led1, step.leds & LED_PATTERN_LED1);
+  _write(_led2, step.leds & LED_PATTERN_LED2);
+  _event_id = _event_queue->call_in(&led_pattern_site,
+                                    std::chrono::milliseconds(step.duration_ms),
+                                    this, &LedPattern::_step);
+}
+
+void LedPattern::_write(DigitalOut &led, int value) {
+  if (led.is_connected()) {
+    led = value ? 1 : 0;
+  }
+}
@@ -0,0 +1,74 @@
+/**
+ * @file led_pattern.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines a non-blocking engine for LED blink patterns.
+ * @bug No known bugs.
+ */
+#ifndef LED_PATTERN_H
+#define LED_PATTERN_H
+
+#include "mbed.h"
+#include "profiled_event_queue.hpp"
+#include <chrono>
+
+#define LED_PATTERN_LED1 0x01
+#define LED_PATTERN_LED2 0x02
+
+/**
+ * @brief A single step of an LED pattern.
+ */
+typedef struct {
+  uint8_t leds;         // Mask of the LEDs that are on during the step
+  uint16_t duration_ms; // How long the step lasts
+} led_step_t;
+
+class LedPattern {
+public:
+  /**
+   * @brief Construct a new LedPattern object.
+   *
+   * @param event_queue The queue that runs the pattern steps.
+   * @param led1 The pin of the first LED, NC if none.
+   * @param led2 The pin of the second LED, NC if none.
+   * @return Instance of LedPattern.
+   */
+  LedPattern(ProfiledEventQueue *event_queue, PinName led1, PinName led2);
+
+  /**
+   * @brief Start playing a pattern, replacing any pattern in progress. All
+   * LEDs are turned off once the last step ends.
+   *
+   * @param steps The steps of the pattern, which must outlive the pattern.
+   * @param count The number of steps.
+   * @return Void.
+   */
+  void play(const led_step_t *steps, int count);
+
+private:
+  ProfiledEventQueue *_event_queue;
+  DigitalOut _led1;
+  DigitalOut _led2;
+  const led_step_t *_steps;
+  int _count;
+  int _index;
+  int _event_id;
+
+  /**
+   * @brief Apply the current step and schedule the next one.
+   *
+   * @return Void.
+   */
+  void _step();
+
+  /**
+   * @brief Drive an LED, skipping LEDs that are not connected.
+   *
+   * @return Void.
+   */
+  void _write(DigitalOut &led, int value);
+};
+
+#endif // LED_PATTERN_H
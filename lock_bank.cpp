@@ -0,0 +1,40 @@
+/**
+ * @file lock_bank.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains functionality for operating a bank of Smart
+ * Locks from one board.
+ * @bug No known bugs.
+ */
+#include "lock_bank.hpp"
+
+/**
+ * @brief The pins of every lock in the bank, indexed by lock address.
+ */
+static const lock_config_t LOCK_CONFIGS[] = MBED_CONF_APP_LOCKS;
+
+LockBank::LockBank(ProfiledEventQueue *event_queue) {
+  _count = sizeof(LOCK_CONFIGS) / sizeof(LOCK_CONFIGS[0]);
+  _locks = new SmartLock *[_count];
+  for (int i = 0; i < _count; i++) {
+    _locks[i] = new SmartLock(event_queue, LOCK_CONFIGS[i], i);
+  }
+}
+
+LockBank::~LockBank() {
+  for (int i = 0; i < _count; i++) {
+    delete _locks[i];
+  }
+  delete[] _locks;
+}
+
+SmartLock *LockBank::get(int index) {
+  if (index < 0 || index >= _count) {
+    return NULL;
+  }
+  return _locks[index];
+}
+
+int LockBank::size() { return _count; }
@@ -0,0 +1,50 @@
+/**
+ * @file lock_bank.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines the class for operating a bank of Smart Locks
+ * from one board.
+ * @bug No known bugs.
+ */
+#ifndef LOCK_BANK_H
+#define LOCK_BANK_H
+
+#include "mbed.h"
+#include "smartlock.hpp"
+
+class LockBank : private mbed::NonCopyable<LockBank> {
+public:
+  /**
+   * @brief Construct a new LockBank object with one Smart Lock per entry of
+   * the 'locks' option in 'mbed_app.json'.
+   *
+   * @param event_queue The queue that runs relocks and LED patterns.
+   * @return Instance of LockBank.
+   */
+  LockBank(ProfiledEventQueue *event_queue);
+
+  ~LockBank();
+
+  /**
+   * @brief Returns the Smart Lock at an index.
+   *
+   * @param index The index of the lock.
+   * @return The lock, NULL if the index is out of range.
+   */
+  SmartLock *get(int index);
+
+  /**
+   * @brief Returns the number of Smart Locks in the bank.
+   *
+   * @return The number of locks.
+   */
+  int size();
+
+private:
+  SmartLock **_locks;
+  int _count;
+};
+
+#endif // LOCK_BANK_H
@@ -12,13 +12,17 @@
  * @bug No known bugs.
  */
 #include "ble_service.hpp"
+#include "boot_profile.hpp"
+#include "codec.hpp"
 #include "datastore.hpp"
 #include "helpers.hpp"
 #include "keys.hpp"
+#include "lock_bank.hpp"
 #include "mbed.h"
-#include "qrcodegen.hpp"
-#include "rtc_service.hpp"
-#include "smartlock.hpp"
+#include "qr_matrix.hpp"
+#include "time_service.hpp"
+#include "totp.hpp"
+#include "trace.hpp"
 #include "wifi_service.hpp"
 #include <chrono>
 #include <cstdint>
@@ -30,28 +34,55 @@ ISM43362Interface wifi(false);
 #endif
 
 using namespace std::chrono;
-using qrcodegen::QrCode;
 
-EventQueue event_queue;
+#define HOUSEKEEPING_QUEUE_EVENTS 32
+
+// Runs BLE, code validation and the locks
+ProfiledEventQueue event_queue;
+// Runs log writes, log dumps and resets, so they never delay an unlock
+EventQueue housekeeping_queue(HOUSEKEEPING_QUEUE_EVENTS *
+                              (EVENTS_EVENT_SIZE + sizeof(log_entry_t)));
+Thread housekeeping_thread(osPriorityBelowNormal, OS_STACK_SIZE, nullptr,
+                           "housekeeping");
 InterruptIn button1(BUTTON1);
 Timer t;
+// The enrollment QR code last shown, kept encoded until another lock's is
+qr_matrix_t enrollment_qr;
+int enrollment_qr_lock = -1;
+// Set once the lock bank is built
+int lock_count = 1;
+
+void print_all_enrollment_qrs();
 
 void button_fall_handler() {
-  event_queue.call(print_logs);
+  housekeeping_queue.call(print_logs);
+  housekeeping_queue.call(print_storage_stats);
+  housekeeping_queue.call(print_ble_stats);
+  housekeeping_queue.call(print_boot_profile);
+  housekeeping_queue.call(print_time_stats);
+  housekeeping_queue.call(&event_queue, &ProfiledEventQueue::print_stats);
+#if MBED_CONF_APP_TRACE_ENABLED
+  housekeeping_queue.call(trace_dump, stdout);
+#endif
   t.reset();
   t.start();
 }
 
-void reset_system() {
+void reset_system(erase_mode_t mode) {
   printf("> Resetting Smart Lock\n");
-  erase_fs();
+  erase_fs(mode);
   NVIC_SystemReset();
 }
 
 void button_rise_handler() {
   t.stop();
-  if (duration_cast<milliseconds>(t.elapsed_time()).count() > 5000) {
-    event_queue.call(reset_system);
+  auto held = duration_cast<milliseconds>(t.elapsed_time()).count();
+  if (held > 15000) {
+    housekeeping_queue.call(reset_system, ERASE_DEEP);
+  } else if (held > 5000) {
+    housekeeping_queue.call(reset_system, ERASE_QUICK);
+  } else if (held > 2000) {
+    housekeeping_queue.call(print_all_enrollment_qrs);
   }
 }
 
@@ -61,7 +92,7 @@ void button_rise_handler() {
  * @return 0 on success, -1 on failure/error
  */
 int generate_private_key() {
-  char secret[PRIVATE_KEY_LENGTH + 1];
+  uint8_t secret[PRIVATE_KEY_SIZE];
   int get_success = get_private_key(secret);
   if (get_success != -1) {
     printf("> Using stored private key\n");
@@ -78,14 +109,14 @@ int generate_private_key() {
   }
 
   size_t exported_length = 0;
-  static uint8_t exported[PRIVATE_KEY_LENGTH / 2];
+  static uint8_t exported[PRIVATE_KEY_SIZE];
   psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
   psa_key_id_t id;
   psa_set_key_usage_flags(&attributes, PSA_KEY_USAGE_EXPORT);
   psa_set_key_algorithm(&attributes,
                         PSA_ALG_DETERMINISTIC_ECDSA(PSA_ALG_SHA_256));
   psa_set_key_type(&attributes, PSA_KEY_TYPE_RAW_DATA);
-  psa_set_key_bits(&attributes, 80);
+  psa_set_key_bits(&attributes, PRIVATE_KEY_SIZE * 8);
 
   status = psa_generate_key(&attributes, &id);
   if (status != PSA_SUCCESS) {
@@ -94,7 +125,7 @@ int generate_private_key() {
   }
 
   status = psa_export_key(id, exported, sizeof(exported), &exported_length);
-  if (status != PSA_SUCCESS || exported_length != 10) {
+  if (status != PSA_SUCCESS || exported_length != PRIVATE_KEY_SIZE) {
     printf("Failed to export key (%d)\n", status);
     return -1;
   }
@@ -102,16 +133,9 @@ int generate_private_key() {
   psa_reset_key_attributes(&attributes);
   mbedtls_psa_crypto_free();
 
-  char key[PRIVATE_KEY_LENGTH + 1];
-  int index = 0;
-  for (int i = 0; i < exported_length; i++) {
-    index += sprintf(&key[index], "%02x", exported[i]);
-  }
-  key[index] = '\0';
-
   printf("> Generated new private key\n");
   write_log("Generated new private key");
-  set_private_key(strupr(key));
+  set_private_key(exported);
   return 0;
 }
 
@@ -121,10 +145,7 @@ int generate_private_key() {
  * @return Void.
  */
 void generate_recovery() {
-  char secret[RECOVERY_KEY_LENGTH + 1];
-  int get_success = get_recovery_keys(secret);
-  if (get_success != -1 &&
-      strcmp(secret, "000000000000000000000000000000000000") != 0) {
+  if (count_recovery_keys() > 0) {
     printf("> Using stored recovery keys\n");
     write_log("Using stored recovery keys");
     return;
@@ -138,7 +159,7 @@ void generate_recovery() {
     return;
   }
 
-  uint8_t random[36] = {0};
+  uint8_t random[RECOVERY_KEY_LENGTH] = {0};
   status = psa_generate_random(random, sizeof(random));
   if (status != PSA_SUCCESS) {
     printf("Failed to generate a random value (%" PRIu32 ")\n", status);
@@ -148,11 +169,7 @@ void generate_recovery() {
   mbedtls_psa_crypto_free();
 
   char keys[RECOVERY_KEY_LENGTH + 1];
-  int index = 0;
-  for (index = 0; index < RECOVERY_KEY_LENGTH; index++) {
-    keys[index] = 'A' + (random[index] % 26);
-  }
-  keys[index] = '\0';
+  format_recovery_keys(random, keys);
 
   printf("> Generated new recovery keys\n");
   write_log("Generated new recovery keys");
@@ -160,79 +177,122 @@ void generate_recovery() {
 }
 
 /**
- * @brief Prints the given QrCode object to the console.
- *
- * From the QR Code generator library (C++)
- * https://www.nayuki.io/page/qr-code-generator-library
+ * @brief Prints the given QR code to the console, two module rows per line.
  *
- * @author Project Nayuki (nayuki)
- * @copyright Copyright (c) Project Nayuki. (MIT License)
+ * @return Void.
  */
-void printQr(const QrCode &qr) {
-  int border = 2;
-  for (int y = -border; y < qr.getSize() + border; y++) {
-    for (int x = -border; x < qr.getSize() + border; x++) {
-      printf(qr.getModule(x, y) ? "⬛⬛" : "⬜⬜");
-    }
-    printf("\n");
+void printQr(const qr_matrix_t *qr) {
+  Timer timer;
+  timer.start();
+  char line[QR_MATRIX_LINE_MAX];
+  size_t bytes = 0;
+  for (int i = 0; i < qr_matrix_line_count(qr); i++) {
+    int length = qr_matrix_render_line(qr, i, line);
+    fwrite(line, 1, length, stdout);
+    bytes += length;
   }
+  fflush(stdout);
+  printf("> Printed QR code in %u bytes, %lld us\n", (unsigned)bytes,
+         duration_cast<microseconds>(timer.elapsed_time()).count());
 }
 
-int hex_to_base32(const char *hex, int length, char *result, int bufSize) {
-  uint8_t *bytes = (uint8_t *)malloc(10);
-  int pos = 0;
-  for (int i = 0; i < 10; i++) {
-    sscanf(hex + pos, "%2hhx", &bytes[i]);
-    pos += 2;
+/**
+ * @brief Prints the otpauth QR code that enrolls an authenticator app for a
+ * lock. The code is encoded once and then kept packed, so its encoder only
+ * allocates when another lock's code is shown.
+ *
+ * @param lock The index of the lock.
+ * @return Void.
+ */
+void print_enrollment_qr(int lock) {
+  if (lock != enrollment_qr_lock) {
+    uint8_t key[PRIVATE_KEY_SIZE];
+    if (get_private_key(key) < 0) {
+      printf("> No private key to enroll\n");
+      return;
+    }
+    uint8_t secret[PRIVATE_KEY_SIZE];
+    derive_lock_secret(key, lock, secret);
+
+    char base32key[BASE32_LENGTH(PRIVATE_KEY_SIZE) + 1];
+    bytes_to_base32(secret, PRIVATE_KEY_SIZE, base32key, sizeof(base32key));
+
+    char qr_uri[sizeof(OTPAUTH_LOCK_URI_FORMAT) + 8 + sizeof(base32key)];
+    if (lock == 0) {
+      snprintf(qr_uri, sizeof(qr_uri), OTPAUTH_URI_FORMAT, base32key);
+    } else {
+      snprintf(qr_uri, sizeof(qr_uri), OTPAUTH_LOCK_URI_FORMAT, lock,
+               base32key);
+    }
+    enrollment_qr_lock = -1;
+    if (qr_matrix_encode(&enrollment_qr, qr_uri) < 0) {
+      printf("Cannot encode the enrollment QR code\n");
+      return;
+    }
+    enrollment_qr_lock = lock;
   }
 
-  length = length / 2;
+  printf("> Scan the following code for lock %d using an authenticator app "
+         "on your mobile device\n",
+         lock);
+  printQr(&enrollment_qr);
+}
 
-  if (length < 0 || length > (1 << 28)) {
-    return -1;
-  }
-  int count = 0;
-  if (length > 0) {
-    int buffer = bytes[0];
-    int next = 1;
-    int bitsLeft = 8;
-    while (count < bufSize && (bitsLeft > 0 || next < length)) {
-      if (bitsLeft < 5) {
-        if (next < length) {
-          buffer <<= 8;
-          buffer |= bytes[next++] & 0xFF;
-          bitsLeft += 8;
-        } else {
-          int pad = 5 - bitsLeft;
-          buffer <<= pad;
-          bitsLeft += pad;
-        }
-      }
-      int index = 0x1F & (buffer >> (bitsLeft - 5));
-      bitsLeft -= 5;
-      result[count++] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567"[index];
-    }
-  }
-  if (count < bufSize) {
-    result[count] = '\000';
+/**
+ * @brief Prints the enrollment QR code of every lock, as each lock has a
+ * secret of its own.
+ *
+ * @return Void.
+ */
+void print_all_enrollment_qrs() {
+  for (int lock = 0; lock < lock_count; lock++) {
+    print_enrollment_qr(lock);
   }
-  return count;
+}
+
+/**
+ * @brief Shows the enrollment QR code of a lock from the housekeeping thread.
+ *
+ * @param lock The index of the lock.
+ * @return Void.
+ */
+void post_enrollment_qr(int lock) {
+  housekeeping_queue.call(print_enrollment_qr, lock);
 }
 
 int main() {
   printf("=== SmartLock booted ===\n");
-
-  SmartLock smart_lock(&event_queue);
+  trace_init();
 
   printf("> Mounting file system\n");
+  Timer boot_timer;
+  boot_timer.start();
   mount_fs();
+  load_keystore();
+  // Locks read their authorized users from the file system
+  LockBank lock_bank(&event_queue);
+  lock_count = lock_bank.size();
+  housekeeping_thread.start(
+      callback(&housekeeping_queue, &EventQueue::dispatch_forever));
+  set_log_queue(&housekeeping_queue);
+  boot_profile_init(&housekeeping_queue);
+  boot_phase_end(BOOT_PHASE_MOUNT);
   write_log("+ Device booted");
+#if MBED_CONF_APP_STORAGE_BENCHMARK
+  run_storage_benchmark();
+#endif
 
   generate_recovery();
-  char recovery[37];
+  boot_phase_end(BOOT_PHASE_RECOVERY_KEYS);
+  generate_private_key();
+  boot_phase_end(BOOT_PHASE_PRIVATE_KEY);
+  printf("> Keys ready in %lld us\n",
+         duration_cast<microseconds>(boot_timer.elapsed_time()).count());
+
+  char recovery[RECOVERY_KEY_LENGTH + 1];
   get_recovery_keys(recovery);
   printf("> Recovery keys:\n");
-  for (int i = 0; i < sizeof(recovery); i++) {
+  for (int i = 0; i < RECOVERY_KEY_LENGTH; i++) {
     if (recovery[i] != '0') {
       printf("%c", recovery[i]);
       if (i % 6 == 5) {
@@ -241,34 +301,17 @@ int main() {
     }
   }
 
-  generate_private_key();
-  char key[21];
-  get_private_key(key);
-
-  char base32key[20];
-  hex_to_base32(key, 20, base32key, 20);
-
-  char qr_uri[52];
-  sprintf(qr_uri, "otpauth://totp/SmartLock?secret=%s", base32key);
-  printf("> Scan the following code using an authenticator app on your mobile "
-         "device\n");
-  const QrCode qr0 = QrCode::encodeText(qr_uri, QrCode::Ecc::MEDIUM);
-  printQr(qr0);
-
-  int status = connect_to_wifi(&wifi);
-  if (status < 0) {
-    sync_rtc_with_factory();
-  } else {
-    sync_rtc_with_ntp(&wifi);
-  }
-  wifi.disconnect();
+  printf("> Hold USER Button for 2 seconds to show the enrollment QR codes\n");
+
+  // Syncs the RTC in the background while BLE is already advertising
+  start_time_service(&wifi);
 
   printf("> Setting up log output\n");
   button1.fall(&button_fall_handler);
   button1.rise(&button_rise_handler);
 
   printf("> Initializing BLE broadcast\n");
-  init_bluetooth(event_queue, &smart_lock);
+  init_bluetooth(event_queue, &lock_bank, post_enrollment_qr);
 
   printf("> Terminated\n");
 }
@@ -0,0 +1,162 @@
+/**
+ * @file ntp.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains the NTP packet handling and sample selection
+ * used to sync the RTC.
+ * @bug No known bugs.
+ */
+#include "ntp.hpp"
+#include <string.h>
+
+/**
+ * @brief Reads a big endian 32-bit value.
+ *
+ * @return The value.
+ */
+static uint32_t read_be32(const uint8_t *data) {
+  return (uint32_t)data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+}
+
+/**
+ * @brief Writes a big endian 32-bit value.
+ *
+ * @return Void.
+ */
+static void write_be32(uint8_t *data, uint32_t value) {
+  data[0] = value >> 24;
+  data[1] = value >> 16;
+  data[2] = value >> 8;
+  data[3] = value;
+}
+
+/**
+ * @brief Converts an NTP timestamp to milliseconds since the Unix epoch.
+ *
+ * @return The Unix time in milliseconds.
+ */
+static int64_t ntp_to_unix_ms(const uint8_t *timestamp) {
+  int64_t seconds = read_be32(timestamp);
+  // NTP seconds wrap in 2036; small values belong to the next era
+  if (seconds < 0x80000000LL) {
+    seconds += 0x100000000LL;
+  }
+  uint64_t fraction = read_be32(timestamp + 4);
+  return (seconds - NTP_UNIX_OFFSET) * 1000 +
+         (int64_t)((fraction * 1000) >> 32);
+}
+
+void ntp_build_request(uint8_t *packet, uint32_t tag) {
+  memset(packet, 0, NTP_PACKET_SIZE);
+  packet[0] = 0x1B; // No leap warning, version 3, client mode
+  // The server copies the transmit timestamp into the originate timestamp
+  write_be32(packet + 40, tag);
+}
+
+int ntp_parse_response(const uint8_t *packet, size_t length, uint32_t tag,
+                       uint64_t sent_ms, uint64_t received_ms,
+                       ntp_sample_t *sample) {
+  if (length < NTP_PACKET_SIZE) {
+    return -1;
+  }
+  int leap = packet[0] >> 6;
+  int mode = packet[0] & 0x07;
+  int stratum = packet[1];
+  // Leap indicator 3 and stratum 0 mean the server is not synchronized
+  if (mode != 4 || leap == 3 || stratum == 0 || stratum > 15) {
+    return -1;
+  }
+  if (read_be32(packet + 24) != tag) {
+    return -1;
+  }
+
+  int64_t server_received = ntp_to_unix_ms(packet + 32);
+  int64_t server_sent = ntp_to_unix_ms(packet + 40);
+  int64_t sent = sent_ms;
+  int64_t received = received_ms;
+
+  int64_t rtt = (received - sent) - (server_sent - server_received);
+  sample->rtt_ms = rtt > 0 ? rtt : 0;
+  sample->offset_ms =
+      ((server_received - sent) + (server_sent - received)) / 2;
+  return 0;
+}
+
+int ntp_select(ntp_sample_t *samples, int count, uint32_t max_deviation_ms,
+               ntp_sample_t *best) {
+  if (count <= 0) {
+    return 0;
+  }
+
+  // Insertion sort by offset, there is one sample per server
+  for (int i = 1; i < count; i++) {
+    ntp_sample_t sample = samples[i];
+    int j = i;
+    while (j > 0 && samples[j - 1].offset_ms > sample.offset_ms) {
+      samples[j] = samples[j - 1];
+      j--;
+    }
+    samples[j] = sample;
+  }
+  int64_t median = (samples[(count - 1) / 2].offset_ms +
+                    samples[count / 2].offset_ms) /
+                   2;
+
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    int64_t deviation = samples[i].offset_ms - median;
+    if (deviation < 0) {
+      deviation = -deviation;
+    }
+    if (deviation > max_deviation_ms) {
+      continue;
+    }
+    if (kept == 0 || samples[i].rtt_ms < best->rtt_ms) {
+      *best = samples[i];
+    }
+    kept++;
+  }
+  return kept;
+}
+
+void ntp_query_init(ntp_query_t *query, uint32_t nonce, int quorum) {
+  memset(query, 0, sizeof(*query));
+  query->nonce = nonce & ~(uint32_t)(NTP_MAX_SERVERS - 1);
+  query->quorum = quorum;
+}
+
+void ntp_query_request(const ntp_query_t *query, int server,
+                       uint8_t *packet) {
+  ntp_build_request(packet, query->nonce | server);
+}
+
+void ntp_query_sent(ntp_query_t *query, int server, uint64_t sent_ms) {
+  query->sent_ms[server] = sent_ms;
+  if (!query->pending[server]) {
+    query->pending[server] = true;
+    query->requests++;
+  }
+}
+
+int ntp_query_answer(ntp_query_t *query, const uint8_t *packet,
+                     size_t length, uint64_t received_ms) {
+  for (int i = 0; i < NTP_MAX_SERVERS; i++) {
+    if (query->pending[i] &&
+        ntp_parse_response(packet, length, query->nonce | i,
+                           query->sent_ms[i], received_ms,
+                           &query->samples[query->answers]) == 0) {
+      query->pending[i] = false;
+      query->answers++;
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool ntp_query_done(const ntp_query_t *query) {
+  int needed =
+      query->quorum < query->requests ? query->quorum : query->requests;
+  return query->answers >= needed;
+}
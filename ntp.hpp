@@ -0,0 +1,141 @@
+/**
+ * @file ntp.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines the NTP packet handling and sample selection
+ * used to sync the RTC. It does no I/O, so it builds on any platform.
+ * @bug No known bugs.
+ */
+#ifndef NTP_H
+#define NTP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NTP_PACKET_SIZE 48
+#define NTP_PORT 123
+// Seconds from the NTP epoch (1900) to the Unix epoch (1970)
+#define NTP_UNIX_OFFSET 2208988800UL
+// Servers queried at once, the low 4 bits of a request tag
+#define NTP_MAX_SERVERS 16
+
+/**
+ * @brief One answer from an NTP server, measured against a local monotonic
+ * millisecond clock.
+ */
+typedef struct {
+  int64_t offset_ms; // Unix time in ms less the local clock
+  uint32_t rtt_ms;   // Round trip, less the time spent in the server
+} ntp_sample_t;
+
+/**
+ * @brief Builds a client request. The tag is echoed back by the server and
+ * identifies the request the answer belongs to.
+ *
+ * @param packet The NTP_PACKET_SIZE byte packet to fill.
+ * @param tag The tag of the request.
+ * @return Void.
+ */
+void ntp_build_request(uint8_t *packet, uint32_t tag);
+
+/**
+ * @brief Checks a server answer and measures its offset and round trip.
+ *
+ * @param packet The answer.
+ * @param length The length of the answer.
+ * @param tag The tag the request was sent with.
+ * @param sent_ms The local clock when the request was sent.
+ * @param received_ms The local clock when the answer arrived.
+ * @param sample The sample to fill.
+ * @return 0 upon success, -1 if the answer is malformed, unsynchronized or
+ * for another request.
+ */
+int ntp_parse_response(const uint8_t *packet, size_t length, uint32_t tag,
+                       uint64_t sent_ms, uint64_t received_ms,
+                       ntp_sample_t *sample);
+
+/**
+ * @brief Rejects samples whose offset is further than max_deviation_ms from
+ * the median offset, then picks the survivor with the shortest round trip,
+ * whose offset is the least affected by asymmetric delays.
+ *
+ * @param samples The samples, reordered by offset.
+ * @param count The number of samples.
+ * @param max_deviation_ms The furthest a sample may be from the median.
+ * @param best The sample to use.
+ * @return The number of samples that were kept, 0 if there were none.
+ */
+int ntp_select(ntp_sample_t *samples, int count, uint32_t max_deviation_ms,
+               ntp_sample_t *best);
+
+/**
+ * @brief The requests of one sync, sent to several servers at once, and the
+ * answers received so far.
+ */
+typedef struct {
+  uint32_t nonce; // Unique to the sync, the low 4 bits are clear
+  int requests;
+  int answers;
+  int quorum;
+  uint64_t sent_ms[NTP_MAX_SERVERS];
+  bool pending[NTP_MAX_SERVERS];
+  ntp_sample_t samples[NTP_MAX_SERVERS]; // The first answers are filled
+} ntp_query_t;
+
+/**
+ * @brief Starts a sync.
+ *
+ * @param query The sync.
+ * @param nonce A value unique to the sync, its low 4 bits are ignored.
+ * @param quorum The number of answers that ends the sync early.
+ * @return Void.
+ */
+void ntp_query_init(ntp_query_t *query, uint32_t nonce, int quorum);
+
+/**
+ * @brief Builds the request for a server.
+ *
+ * @param query The sync.
+ * @param server The index of the server, below NTP_MAX_SERVERS.
+ * @param packet The NTP_PACKET_SIZE byte packet to fill.
+ * @return Void.
+ */
+void ntp_query_request(const ntp_query_t *query, int server, uint8_t *packet);
+
+/**
+ * @brief Records that the request for a server was sent, so its answer is
+ * expected.
+ *
+ * @param query The sync.
+ * @param server The index of the server.
+ * @param sent_ms The local clock right before the request was sent.
+ * @return Void.
+ */
+void ntp_query_sent(ntp_query_t *query, int server, uint64_t sent_ms);
+
+/**
+ * @brief Matches an answer to the request it belongs to and keeps it as a
+ * sample. Duplicate and unexpected answers are ignored.
+ *
+ * @param query The sync.
+ * @param packet The answer.
+ * @param length The length of the answer.
+ * @param received_ms The local clock when the answer arrived.
+ * @return The index of the server that answered, -1 if the answer is not
+ * used.
+ */
+int ntp_query_answer(ntp_query_t *query, const uint8_t *packet,
+                     size_t length, uint64_t received_ms);
+
+/**
+ * @brief Returns whether enough servers have answered, which is the quorum
+ * or every server that was asked, whichever is fewer.
+ *
+ * @param query The sync.
+ * @return True once no more answers are needed.
+ */
+bool ntp_query_done(const ntp_query_t *query);
+
+#endif // NTP_H
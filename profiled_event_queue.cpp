@@ -0,0 +1,80 @@
+/**
+ * @file profiled_event_queue.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains an event queue that measures how long events
+ * wait and run, grouped by the place they were posted from.
+ * @bug No known bugs.
+ */
+#include "profiled_event_queue.hpp"
+
+/**
+ * @brief Reads the microsecond ticker, which is safe from interrupts.
+ *
+ * @return The current time in microseconds.
+ */
+static uint64_t now_us() { return ticker_read_us(get_us_ticker_data()); }
+
+ProfiledEventQueue::ProfiledEventQueue(unsigned size) : EventQueue(size) {}
+
+bool ProfiledEventQueue::cancel(int id) {
+  if (!EventQueue::cancel(id)) {
+    return false;
+  }
+  _dequeue();
+  return true;
+}
+
+const queue_site_t *ProfiledEventQueue::site(int index) {
+  const queue_site_t *site = _sites;
+  while (site && index-- > 0) {
+    site = site->next;
+  }
+  return site;
+}
+
+void ProfiledEventQueue::print_stats() {
+  printf("> Event queue has %u events pending\n", _pending);
+  for (const queue_site_t *site = _sites; site; site = site->next) {
+    printf("> %s: peak depth %u\n", site->name, site->peak_depth);
+    latency_print(&site->wait, "  Wait");
+    latency_print(&site->run, "  Run");
+  }
+}
+
+uint64_t ProfiledEventQueue::_enqueue(queue_site_t *site) {
+  // Events are posted from BLE stack callbacks and interrupts as well
+  CriticalSectionLock lock;
+  _pending++;
+  if (_pending > site->peak_depth) {
+    site->peak_depth = _pending;
+  }
+  if (!site->registered) {
+    site->registered = true;
+    // Append, so sites keep the order they first posted in
+    queue_site_t **tail = &_sites;
+    while (*tail) {
+      tail = &(*tail)->next;
+    }
+    *tail = site;
+  }
+  return now_us();
+}
+
+uint64_t ProfiledEventQueue::_dequeue() {
+  CriticalSectionLock lock;
+  if (_pending > 0) {
+    _pending--;
+  }
+  return now_us();
+}
+
+void ProfiledEventQueue::_record(queue_site_t *site, uint64_t due,
+                                 uint64_t start) {
+  uint64_t end = now_us();
+  // Delayed events can be dispatched marginally before they are due
+  latency_record(&site->wait, start > due ? start - due : 0);
+  latency_record(&site->run, end - start);
+}
@@ -0,0 +1,167 @@
+/**
+ * @file profiled_event_queue.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines an event queue that measures how long events
+ * wait and run, grouped by the place they were posted from.
+ * @bug No known bugs.
+ */
+#ifndef PROFILED_EVENT_QUEUE_H
+#define PROFILED_EVENT_QUEUE_H
+
+#include "latency_histogram.hpp"
+#include "mbed.h"
+#include <chrono>
+
+#define QUEUE_SITE_NAME_LENGTH 12
+
+/**
+ * @brief The statistics of the events posted from one place.
+ */
+typedef struct queue_site {
+  const char *name;
+  latency_histogram_t wait; // From when the event was due to when it ran
+  latency_histogram_t run;  // How long the event ran for
+  uint16_t peak_depth;      // Most events pending when one was posted here
+  bool registered;
+  struct queue_site *next;
+} queue_site_t;
+
+/**
+ * @brief Declares the statistics of a call site.
+ *
+ * @param site_name The name printed with the statistics, at most
+ * QUEUE_SITE_NAME_LENGTH characters.
+ */
+#define QUEUE_SITE(site_name)                                                  \
+  { site_name, {}, {}, 0, false, NULL }
+
+/**
+ * @brief An EventQueue whose events are tagged with the call site that posted
+ * them. Events posted through the plain EventQueue methods are not counted.
+ */
+class ProfiledEventQueue : public events::EventQueue {
+public:
+  /**
+   * @brief Construct a new ProfiledEventQueue object.
+   *
+   * @param size The size of the event buffer in bytes.
+   * @return Instance of ProfiledEventQueue.
+   */
+  ProfiledEventQueue(unsigned size = EVENTS_QUEUE_SIZE);
+
+  /**
+   * @brief Posts an event to run as soon as possible.
+   *
+   * @param site The statistics of the call site.
+   * @param f The function to run.
+   * @return The id of the event, 0 if the queue is full.
+   */
+  template <typename F> int call(queue_site_t *site, F f) {
+    return _post(site, 0, f);
+  }
+
+  /**
+   * @brief Posts a member function to run as soon as possible.
+   *
+   * @return The id of the event, 0 if the queue is full.
+   */
+  template <typename T, typename R>
+  int call(queue_site_t *site, T *obj, R (T::*method)()) {
+    return _post(site, 0, mbed::callback(obj, method));
+  }
+
+  /**
+   * @brief Posts an event to run after a delay. Time spent waiting past the
+   * delay is recorded as the wait.
+   *
+   * @param site The statistics of the call site.
+   * @param delay The delay before the event runs.
+   * @param f The function to run.
+   * @return The id of the event, 0 if the queue is full.
+   */
+  template <typename F>
+  int call_in(queue_site_t *site, std::chrono::milliseconds delay, F f) {
+    return _post(site, delay.count(), f);
+  }
+
+  /**
+   * @brief Posts a member function to run after a delay.
+   *
+   * @return The id of the event, 0 if the queue is full.
+   */
+  template <typename T, typename R>
+  int call_in(queue_site_t *site, std::chrono::milliseconds delay, T *obj,
+              R (T::*method)()) {
+    return _post(site, delay.count(), mbed::callback(obj, method));
+  }
+
+  /**
+   * @brief Cancels a pending event.
+   *
+   * @param id The id of the event.
+   * @return True if the event was cancelled before it ran.
+   */
+  bool cancel(int id);
+
+  /**
+   * @brief Returns the statistics of a call site that has posted events.
+   *
+   * @param index The index of the call site, in the order they first posted.
+   * @return The statistics, NULL past the last call site.
+   */
+  const queue_site_t *site(int index);
+
+  /**
+   * @brief Prints the statistics of every call site.
+   *
+   * @return Void.
+   */
+  void print_stats();
+
+private:
+  volatile uint16_t _pending = 0;
+  queue_site_t *_sites = NULL;
+
+  template <typename F>
+  int _post(queue_site_t *site, uint32_t delay_ms, F f) {
+    uint64_t due = _enqueue(site) + delay_ms * 1000ULL;
+    auto profiled = [this, site, due, f]() mutable {
+      uint64_t start = _dequeue();
+      f();
+      _record(site, due, start);
+    };
+    int id = delay_ms ? EventQueue::call_in(std::chrono::milliseconds(delay_ms),
+                                            profiled)
+                      : EventQueue::call(profiled);
+    if (!id) {
+      _dequeue();
+    }
+    return id;
+  }
+
+  /**
+   * @brief Counts a posted event and registers its call site.
+   *
+   * @return The current time in microseconds.
+   */
+  uint64_t _enqueue(queue_site_t *site);
+
+  /**
+   * @brief Counts an event leaving the queue.
+   *
+   * @return The current time in microseconds.
+   */
+  uint64_t _dequeue();
+
+  /**
+   * @brief Records how long an event waited and ran.
+   *
+   * @return Void.
+   */
+  void _record(queue_site_t *site, uint64_t due, uint64_t start);
+};
+
+#endif // PROFILED_EVENT_QUEUE_H
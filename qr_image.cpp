@@ -0,0 +1,205 @@
+/**
+ * @file qr_image.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains writers that stream a packed QR code as a PBM,
+ * PNG or SVG image, one row at a time, for printing provisioning labels.
+ * @bug No known bugs.
+ */
+#include "qr_image.hpp"
+#include "helpers.hpp"
+#include <string.h>
+
+/**
+ * @brief Returns the width and height of the image in pixels.
+ *
+ * @return The width of the image.
+ */
+static int image_width(const qr_matrix_t *matrix, int scale) {
+  return (matrix->size + 2 * QR_MATRIX_BORDER) * scale;
+}
+
+/**
+ * @brief Renders one pixel row, one bit per pixel, most significant bit
+ * first, with dark pixels set. Padding bits at the end are clear.
+ *
+ * @return Void.
+ */
+static void render_row(const qr_matrix_t *matrix, int scale, int y,
+                       uint8_t *row) {
+  int width = image_width(matrix, scale);
+  int module_y = y / scale - QR_MATRIX_BORDER;
+  memset(row, 0, (width + 7) / 8);
+  for (int x = 0; x < width; x++) {
+    if (qr_matrix_get(matrix, x / scale - QR_MATRIX_BORDER, module_y)) {
+      row[x >> 3] |= 0x80 >> (x & 7);
+    }
+  }
+}
+
+int qr_image_write_pbm(const qr_matrix_t *matrix, int scale, FILE *out) {
+  if (matrix->size == 0 || scale < 1 || scale > QR_IMAGE_MAX_SCALE) {
+    return -1;
+  }
+  int width = image_width(matrix, scale);
+  int row_bytes = (width + 7) / 8;
+  uint8_t row[QR_IMAGE_ROW_BYTES];
+
+  fprintf(out, "P4\n%d %d\n", width, width);
+  for (int y = 0; y < width; y++) {
+    // Rows of the same module row repeat, so only render the first
+    if (y % scale == 0) {
+      render_row(matrix, scale, y, row);
+    }
+    fwrite(row, 1, row_bytes, out);
+  }
+  return ferror(out) ? -1 : 0;
+}
+
+/**
+ * @brief Updates an Adler-32 as used by zlib streams.
+ *
+ * @return The updated checksum.
+ */
+static uint32_t adler32_update(uint32_t adler, const uint8_t *data,
+                               size_t len) {
+  uint32_t a = adler & 0xFFFF;
+  uint32_t b = adler >> 16;
+  for (size_t i = 0; i < len; i++) {
+    a = (a + data[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  return b << 16 | a;
+}
+
+/**
+ * @brief Writes a big endian 32-bit value.
+ *
+ * @return Void.
+ */
+static void write_be32(uint8_t *data, uint32_t value) {
+  data[0] = value >> 24;
+  data[1] = value >> 16;
+  data[2] = value >> 8;
+  data[3] = value;
+}
+
+/**
+ * @brief Writes bytes that belong to the data of the current chunk.
+ *
+ * @return The updated chunk CRC.
+ */
+static uint32_t write_chunk_data(FILE *out, uint32_t crc, const uint8_t *data,
+                                 size_t len) {
+  fwrite(data, 1, len, out);
+  return crc32_update(crc, data, len);
+}
+
+/**
+ * @brief Writes the length and type that open a chunk.
+ *
+ * @return The CRC of the chunk so far.
+ */
+static uint32_t begin_chunk(FILE *out, const char *type, uint32_t length) {
+  uint8_t header[4];
+  write_be32(header, length);
+  fwrite(header, 1, sizeof(header), out);
+  return write_chunk_data(out, 0xFFFFFFFF, (const uint8_t *)type, 4);
+}
+
+/**
+ * @brief Writes the CRC that closes a chunk.
+ *
+ * @return Void.
+ */
+static void end_chunk(FILE *out, uint32_t crc) {
+  uint8_t trailer[4];
+  write_be32(trailer, ~crc);
+  fwrite(trailer, 1, sizeof(trailer), out);
+}
+
+int qr_image_write_png(const qr_matrix_t *matrix, int scale, FILE *out) {
+  if (matrix->size == 0 || scale < 1 || scale > QR_IMAGE_MAX_SCALE) {
+    return -1;
+  }
+  static const uint8_t SIGNATURE[8] = {0x89, 'P',  'N',  'G',
+                                       '\r', '\n', 0x1A, '\n'};
+  int width = image_width(matrix, scale);
+  int row_bytes = (width + 7) / 8;
+  fwrite(SIGNATURE, 1, sizeof(SIGNATURE), out);
+
+  // Width, height, bit depth 1, grayscale, no interlacing
+  uint8_t ihdr[13] = {0};
+  write_be32(ihdr, width);
+  write_be32(ihdr + 4, width);
+  ihdr[8] = 1;
+  uint32_t crc = begin_chunk(out, "IHDR", sizeof(ihdr));
+  end_chunk(out, write_chunk_data(out, crc, ihdr, sizeof(ihdr)));
+
+  // Every row is a filter byte and its pixels in a stored block of its own,
+  // so the size of the single IDAT chunk is known before any row is rendered
+  uint32_t block_length = 1 + row_bytes;
+  uint32_t idat_length = 2 + width * (5 + block_length) + 4;
+  static const uint8_t ZLIB_HEADER[2] = {0x78, 0x01};
+  crc = begin_chunk(out, "IDAT", idat_length);
+  crc = write_chunk_data(out, crc, ZLIB_HEADER, sizeof(ZLIB_HEADER));
+
+  uint8_t block[5 + 1 + QR_IMAGE_ROW_BYTES];
+  uint32_t adler = 1;
+  for (int y = 0; y < width; y++) {
+    uint8_t *row = block + 6;
+    if (y % scale == 0) {
+      render_row(matrix, scale, y, row);
+      // PNG grayscale has black at 0, the opposite of a PBM
+      for (int i = 0; i < row_bytes; i++) {
+        row[i] = ~row[i];
+      }
+    }
+    block[0] = y == width - 1; // Final block flag, stored block type
+    block[1] = block_length & 0xFF;
+    block[2] = block_length >> 8;
+    block[3] = ~block_length & 0xFF;
+    block[4] = ~block_length >> 8;
+    block[5] = 0; // No filter
+    crc = write_chunk_data(out, crc, block, 5 + block_length);
+    adler = adler32_update(adler, block + 5, block_length);
+  }
+  uint8_t trailer[4];
+  write_be32(trailer, adler);
+  end_chunk(out, write_chunk_data(out, crc, trailer, sizeof(trailer)));
+
+  end_chunk(out, begin_chunk(out, "IEND", 0));
+  return ferror(out) ? -1 : 0;
+}
+
+int qr_image_write_svg(const qr_matrix_t *matrix, FILE *out) {
+  if (matrix->size == 0) {
+    return -1;
+  }
+  int width = matrix->size + 2 * QR_MATRIX_BORDER;
+  fprintf(out,
+          "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 %d %d\" "
+          "shape-rendering=\"crispEdges\">\n"
+          "<rect width=\"100%%\" height=\"100%%\" fill=\"#fff\"/>\n"
+          "<path fill=\"#000\" d=\"",
+          width, width);
+  for (int y = 0; y < matrix->size; y++) {
+    int x = 0;
+    while (x < matrix->size) {
+      if (!qr_matrix_get(matrix, x, y)) {
+        x++;
+        continue;
+      }
+      int start = x;
+      while (x < matrix->size && qr_matrix_get(matrix, x, y)) {
+        x++;
+      }
+      fprintf(out, "M%d %dh%dv1h-%dz", start + QR_MATRIX_BORDER,
+              y + QR_MATRIX_BORDER, x - start, x - start);
+    }
+  }
+  fprintf(out, "\"/>\n</svg>\n");
+  return ferror(out) ? -1 : 0;
+}
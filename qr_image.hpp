@@ -0,0 +1,54 @@
+/**
+ * @file qr_image.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines writers that stream a packed QR code as a PBM,
+ * PNG or SVG image, one row at a time, for printing provisioning labels.
+ * @bug No known bugs.
+ */
+#ifndef QR_IMAGE_H
+#define QR_IMAGE_H
+
+#include "qr_matrix.hpp"
+#include <stdio.h>
+
+// Pixels per module, bounds the row buffer kept on the stack
+#define QR_IMAGE_MAX_SCALE 16
+#define QR_IMAGE_MAX_WIDTH                                                     \
+  ((QR_MATRIX_MAX_SIZE + 2 * QR_MATRIX_BORDER) * QR_IMAGE_MAX_SCALE)
+#define QR_IMAGE_ROW_BYTES ((QR_IMAGE_MAX_WIDTH + 7) / 8)
+
+/**
+ * @brief Writes a binary PBM (P4) image.
+ *
+ * @param matrix The QR code.
+ * @param scale The pixels per module, from 1 to QR_IMAGE_MAX_SCALE.
+ * @param out The stream to write to.
+ * @return 0 upon success, -1 on error / failure.
+ */
+int qr_image_write_pbm(const qr_matrix_t *matrix, int scale, FILE *out);
+
+/**
+ * @brief Writes a 1-bit grayscale PNG image. The pixels are kept in stored
+ * deflate blocks, one per row, so no compressor is needed.
+ *
+ * @param matrix The QR code.
+ * @param scale The pixels per module, from 1 to QR_IMAGE_MAX_SCALE.
+ * @param out The stream to write to.
+ * @return 0 upon success, -1 on error / failure.
+ */
+int qr_image_write_png(const qr_matrix_t *matrix, int scale, FILE *out);
+
+/**
+ * @brief Writes an SVG image with one unit per module. Dark modules are
+ * merged into one rectangle per horizontal run.
+ *
+ * @param matrix The QR code.
+ * @param out The stream to write to.
+ * @return 0 upon success, -1 on error / failure.
+ */
+int qr_image_write_svg(const qr_matrix_t *matrix, FILE *out);
+
+#endif // QR_IMAGE_H
@@ -0,0 +1,57 @@
+/**
+ * @file qr_matrix.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains a QR code packed into bit rows, which outlives
+ * the heap allocations made while encoding it.
+ * @bug No known bugs.
+ */
+#include "qr_matrix.hpp"
+#include <string.h>
+
+using qrcodegen::QrCode;
+
+int qr_matrix_pack(qr_matrix_t *matrix, const QrCode &qr) {
+  int size = qr.getSize();
+  if (size > QR_MATRIX_MAX_SIZE) {
+    matrix->size = 0;
+    return -1;
+  }
+  memset(matrix->rows, 0, sizeof(matrix->rows));
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      if (qr.getModule(x, y)) {
+        matrix->rows[y][x >> 3] |= 0x80 >> (x & 7);
+      }
+    }
+  }
+  matrix->size = size;
+  return 0;
+}
+
+int qr_matrix_render_line(const qr_matrix_t *matrix, int line, char *buf) {
+  // Indexed by top module light << 1 | bottom module light
+  static const char *const HALF_BLOCKS[4] = {" ", "\u2584", "\u2580",
+                                             "\u2588"};
+  int top = line * 2 - QR_MATRIX_BORDER;
+  int length = 0;
+  for (int x = -QR_MATRIX_BORDER; x < matrix->size + QR_MATRIX_BORDER; x++) {
+    int index = !qr_matrix_get(matrix, x, top) << 1 |
+                !qr_matrix_get(matrix, x, top + 1);
+    const char *block = HALF_BLOCKS[index];
+    while (*block) {
+      buf[length++] = *block++;
+    }
+  }
+  buf[length++] = '\n';
+  buf[length] = '\0';
+  return length;
+}
+
+int qr_matrix_encode(qr_matrix_t *matrix, const char *text) {
+  // The QrCode and its vectors are freed before returning
+  const QrCode qr = QrCode::encodeText(text, QrCode::Ecc::MEDIUM);
+  return qr_matrix_pack(matrix, qr);
+}
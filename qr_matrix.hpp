@@ -0,0 +1,87 @@
+/**
+ * @file qr_matrix.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines a QR code packed into bit rows, which outlives
+ * the heap allocations made while encoding it.
+ * @bug No known bugs.
+ */
+#ifndef QR_MATRIX_H
+#define QR_MATRIX_H
+
+#include "qrcodegen.hpp"
+#include <stdint.h>
+
+// Version 10, far more than an otpauth URI needs
+#define QR_MATRIX_MAX_SIZE 57
+#define QR_MATRIX_ROW_BYTES ((QR_MATRIX_MAX_SIZE + 7) / 8)
+#define QR_MATRIX_BORDER 2
+// A rendered line: 3 UTF-8 bytes per module column, a newline and a NUL
+#define QR_MATRIX_LINE_MAX                                                     \
+  ((QR_MATRIX_MAX_SIZE + 2 * QR_MATRIX_BORDER) * 3 + 2)
+
+/**
+ * @brief The modules of a QR code, one bit each, most significant bit first.
+ */
+typedef struct {
+  int size; // Modules per side, 0 if empty
+  uint8_t rows[QR_MATRIX_MAX_SIZE][QR_MATRIX_ROW_BYTES];
+} qr_matrix_t;
+
+/**
+ * @brief Packs an encoded QR code.
+ *
+ * @param matrix The matrix to fill.
+ * @param qr The QR code.
+ * @return 0 upon success, -1 if the code is larger than QR_MATRIX_MAX_SIZE.
+ */
+int qr_matrix_pack(qr_matrix_t *matrix, const qrcodegen::QrCode &qr);
+
+/**
+ * @brief Encodes text with medium error correction and packs it.
+ *
+ * @param matrix The matrix to fill.
+ * @param text The text to encode.
+ * @return 0 upon success, -1 on error / failure.
+ */
+int qr_matrix_encode(qr_matrix_t *matrix, const char *text);
+
+/**
+ * @brief Returns a module, where modules outside the code are light.
+ *
+ * @param matrix The matrix.
+ * @param x The column.
+ * @param y The row.
+ * @return True for a dark module.
+ */
+inline bool qr_matrix_get(const qr_matrix_t *matrix, int x, int y) {
+  if (x < 0 || y < 0 || x >= matrix->size || y >= matrix->size) {
+    return false;
+  }
+  return matrix->rows[y][x >> 3] & (0x80 >> (x & 7));
+}
+
+/**
+ * @brief Renders two module rows as one line of Unicode half blocks. Light
+ * modules are drawn, so the code reads correctly on a dark terminal.
+ *
+ * @param matrix The matrix.
+ * @param line The line, from 0 to qr_matrix_line_count() - 1.
+ * @param buf The buffer to render into, at least QR_MATRIX_LINE_MAX bytes.
+ * @return The length of the line, including its newline.
+ */
+int qr_matrix_render_line(const qr_matrix_t *matrix, int line, char *buf);
+
+/**
+ * @brief Returns the number of lines a matrix renders to, border included.
+ *
+ * @param matrix The matrix.
+ * @return The number of lines.
+ */
+inline int qr_matrix_line_count(const qr_matrix_t *matrix) {
+  return (matrix->size + 2 * QR_MATRIX_BORDER + 1) / 2;
+}
+
+#endif // QR_MATRIX_H
@@ -9,32 +9,296 @@
  */
 #include "rtc_service.hpp"
 
+using namespace std::chrono;
+
+static const char *const NTP_SERVERS[] = MBED_CONF_APP_NTP_SERVERS;
+static const int NTP_SERVER_COUNT =
+    sizeof(NTP_SERVERS) / sizeof(NTP_SERVERS[0]);
+static_assert(sizeof(NTP_SERVERS) / sizeof(NTP_SERVERS[0]) <= NTP_MAX_SERVERS,
+              "ntp-servers holds at most 16 servers");
+
+// Syncs closer together than this are too short to measure drift over
+#define RTC_MIN_DRIFT_INTERVAL_S 3600
+// Allowance for error in the learned drift rate
+#define RTC_DRIFT_MARGIN_PPB 2000
+// Error left by setting the RTC, which only holds whole seconds
+#define RTC_SYNC_ERROR_MS 500
+
+/**
+ * @brief Reads the local monotonic clock.
+ *
+ * @return Milliseconds since the kernel started.
+ */
+static uint64_t now_ms() {
+  return duration_cast<milliseconds>(Kernel::Clock::now().time_since_epoch())
+      .count();
+}
+
+static rtc_model_t rtc_model;
+static bool rtc_model_loaded = false;
+
+/**
+ * @brief Stores the RTC model.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int save_rtc_model() {
+  rtc_model.magic = RTC_MODEL_MAGIC;
+  rtc_model.crc = crc32(&rtc_model, offsetof(rtc_model_t, crc));
+
+  FILE *f = fopen(RTC_MODEL_PATH, "wb");
+  if (!f) {
+    printf("Cannot open file for write %s: %s\n", RTC_MODEL_PATH,
+           strerror(errno));
+    return -1;
+  }
+  size_t written = fwrite(&rtc_model, sizeof(rtc_model), 1, f);
+  fclose(f);
+  if (written != 1) {
+    printf("Cannot write %s: %s\n", RTC_MODEL_PATH, strerror(errno));
+    return -1;
+  }
+  rtc_model_loaded = true;
+  return 0;
+}
+
+int load_rtc_model() {
+  FILE *f = fopen(RTC_MODEL_PATH, "rb");
+  if (!f) {
+    return -1;
+  }
+  size_t read = fread(&rtc_model, sizeof(rtc_model), 1, f);
+  fclose(f);
+  rtc_model_loaded =
+      read == 1 && rtc_model.magic == RTC_MODEL_MAGIC &&
+      rtc_model.crc == crc32(&rtc_model, offsetof(rtc_model_t, crc));
+  return rtc_model_loaded ? 0 : -1;
+}
+
+/**
+ * @brief Returns the rate the RTC error is assumed to grow at.
+ *
+ * @return The rate in parts per billion.
+ */
+static uint32_t rtc_error_rate_ppb() {
+  if (!rtc_model.drift_syncs) {
+    return MBED_CONF_APP_RTC_ASSUMED_DRIFT_PPM * 1000;
+  }
+  int32_t drift = rtc_model.drift_ppb;
+  return (drift < 0 ? -drift : drift) + RTC_DRIFT_MARGIN_PPB;
+}
+
+uint32_t rtc_predicted_error_ms() {
+  time_t now = time(NULL);
+  // An RTC behind its last sync has lost power and restarted
+  if (!rtc_model_loaded || now < (time_t)rtc_model.last_sync) {
+    return UINT32_MAX;
+  }
+  uint64_t elapsed = now - rtc_model.last_sync;
+  uint64_t error = RTC_SYNC_ERROR_MS + elapsed * rtc_error_rate_ppb() / 1000000;
+  return error < UINT32_MAX ? error : UINT32_MAX;
+}
+
+uint32_t rtc_ms_until_resync() {
+  uint32_t error = rtc_predicted_error_ms();
+  if (error >= MBED_CONF_APP_RTC_MAX_ERROR_MS) {
+    return 0;
+  }
+  uint64_t ms = (uint64_t)(MBED_CONF_APP_RTC_MAX_ERROR_MS - error) *
+                1000000000 / rtc_error_rate_ppb();
+  return ms < UINT32_MAX ? ms : UINT32_MAX;
+}
+
+/**
+ * @brief Measures how far the RTC is from the true time by waiting for it to
+ * tick over to the next second, which can take up to a second.
+ *
+ * @param offset_ms Unix time in ms less the local monotonic clock.
+ * @return The RTC time less the true time in milliseconds.
+ */
+static int64_t measure_rtc_error_ms(int64_t offset_ms) {
+  time_t rtc_time = time(NULL);
+  while (time(NULL) == rtc_time) {
+    ThisThread::sleep_for(1ms);
+  }
+  return (int64_t)(rtc_time + 1) * 1000 - (int64_t)(now_ms() + offset_ms);
+}
+
+/**
+ * @brief Updates the drift rate from how far the RTC drifted since the last
+ * sync, then records this sync.
+ *
+ * @param now The true Unix time.
+ * @param error The RTC time less the true time in milliseconds.
+ * @return Void.
+ */
+static void update_rtc_model(time_t now, int64_t error) {
+  int64_t elapsed = now - rtc_model.last_sync;
+  if (elapsed >= RTC_MIN_DRIFT_INTERVAL_S) {
+    int32_t drift = error * 1000000 / elapsed;
+    // Average with the previous rate, so one noisy sync cannot dominate
+    rtc_model.drift_ppb =
+        rtc_model.drift_syncs ? (rtc_model.drift_ppb + drift) / 2 : drift;
+    rtc_model.drift_syncs++;
+    printf("> RTC was %lld ms off after %lld s, drift now %ld ppb\n",
+           (long long)error, (long long)elapsed, (long)rtc_model.drift_ppb);
+  }
+  rtc_model.last_sync = now;
+  save_rtc_model();
+}
+
+/**
+ * @brief Sets the RTC on the next true second boundary, so it is in phase
+ * with the true time.
+ *
+ * @param offset_ms Unix time in ms less the local monotonic clock.
+ * @param limit Whether to move the RTC by at most a second.
+ * @return The RTC time less the true time in seconds after setting it.
+ */
+static time_t set_rtc_on_boundary(int64_t offset_ms, bool limit) {
+  int64_t unix_ms = now_ms() + offset_ms;
+  ThisThread::sleep_for(milliseconds(1000 - unix_ms % 1000));
+  unix_ms = now_ms() + offset_ms;
+  time_t timestamp = (unix_ms + 500) / 1000;
+  time_t target = timestamp;
+  if (limit) {
+    time_t rtc_time = time(NULL);
+    if (target > rtc_time + 1) {
+      target = rtc_time + 1;
+    } else if (target < rtc_time - 1) {
+      target = rtc_time - 1;
+    }
+  }
+  set_time(target);
+  return target - timestamp;
+}
+
+int64_t correct_rtc(int64_t offset_ms, bool slew) {
+  time_t now = (now_ms() + offset_ms) / 1000;
+  bool running = rtc_predicted_error_ms() != UINT32_MAX;
+  if (!running) {
+    // The RTC lost power, there is no drift to learn from
+    if (!rtc_model_loaded) {
+      memset(&rtc_model, 0, sizeof(rtc_model));
+    }
+    rtc_model.last_sync = now;
+    save_rtc_model();
+    set_rtc_on_boundary(offset_ms, false);
+    time_t timestamp = time(NULL);
+    printf("> Synced RTC to %s", ctime(&timestamp));
+    return 0;
+  }
+
+  int64_t error = measure_rtc_error_ms(offset_ms);
+  update_rtc_model(now, error);
+
+  if (!slew || error > MBED_CONF_APP_RTC_SLEW_MAX_MS ||
+      error < -MBED_CONF_APP_RTC_SLEW_MAX_MS) {
+    set_rtc_on_boundary(offset_ms, false);
+    printf("> Stepped RTC by %lld ms\n", (long long)-error);
+    return -error;
+  }
+
+  // Move the RTC a second at a time, so codes are never skipped or repeated
+  // by more than a second
+  printf("> Slewing RTC by %lld ms\n", (long long)-error);
+  while (set_rtc_on_boundary(offset_ms, true) != 0) {
+    ThisThread::sleep_for(milliseconds(MBED_CONF_APP_RTC_SLEW_INTERVAL_MS));
+  }
+  time_t timestamp = time(NULL);
+  printf("> Synced RTC to %s", ctime(&timestamp));
+  return -error;
+}
+
 void sync_rtc_with_factory() {
   set_time(1648016868);
   time_t factory_time = time(NULL);
   printf("> Defaulted RTC to %s", ctime(&factory_time));
 }
 
-void sync_rtc_with_ntp(NetworkInterface *wifi) {
-  NTPClient ntp(wifi);
+int query_ntp(NetworkInterface *wifi, int64_t *offset_ms) {
+  Timer timer;
+  timer.start();
 
-  time_t timestamp = -1;
+  // Resolve every server first, so the requests leave back to back
+  SocketAddress addresses[NTP_SERVER_COUNT];
+  bool resolved[NTP_SERVER_COUNT];
+  for (int i = 0; i < NTP_SERVER_COUNT; i++) {
+    resolved[i] =
+        wifi->gethostbyname(NTP_SERVERS[i], &addresses[i]) == NSAPI_ERROR_OK;
+    if (!resolved[i]) {
+      printf("Cannot resolve NTP server %s\n", NTP_SERVERS[i]);
+    }
+    addresses[i].set_port(NTP_PORT);
+  }
+
+  UDPSocket socket;
+  if (socket.open(wifi) != NSAPI_ERROR_OK) {
+    printf("Cannot open NTP socket\n");
+    return -1;
+  }
 
-  for (int i = 0; i < 4; i++) {
-    ntp.set_server("1.pool.ntp.org", 123);
+  // Tags are unique to this sync, the low bits hold the server index. The
+  // query is kept off the stack of the time thread
+  static ntp_query_t query;
+  ntp_query_init(&query, (uint32_t)now_ms() << 4, MBED_CONF_APP_NTP_QUORUM);
+  uint8_t packet[NTP_PACKET_SIZE];
+  for (int i = 0; i < NTP_SERVER_COUNT; i++) {
+    if (!resolved[i]) {
+      continue;
+    }
+    ntp_query_request(&query, i, packet);
+    uint64_t sent_ms = now_ms();
+    if (socket.sendto(addresses[i], packet, sizeof(packet)) ==
+        NTP_PACKET_SIZE) {
+      ntp_query_sent(&query, i, sent_ms);
+    }
+  }
 
-    time_t new_timestamp = ntp.get_timestamp();
-    if ((int)timestamp < 0 || timestamp == new_timestamp ||
-        timestamp + 1 == new_timestamp) {
-      timestamp = new_timestamp;
+  while (!ntp_query_done(&query)) {
+    int remaining = MBED_CONF_APP_NTP_TIMEOUT_MS -
+                    duration_cast<milliseconds>(timer.elapsed_time()).count();
+    if (remaining <= 0) {
+      break;
+    }
+    socket.set_timeout(remaining);
+    SocketAddress from;
+    nsapi_size_or_error_t length =
+        socket.recvfrom(&from, packet, sizeof(packet));
+    uint64_t received_ms = now_ms();
+    if (length == NSAPI_ERROR_WOULD_BLOCK) {
+      break;
+    }
+    if (length < 0) {
+      continue;
+    }
+    int server = ntp_query_answer(&query, packet, length, received_ms);
+    if (server >= 0) {
+      const ntp_sample_t &sample = query.samples[query.answers - 1];
+      printf("> %s answered with offset %lld ms, round trip %lu ms\n",
+             NTP_SERVERS[server], (long long)sample.offset_ms,
+             (unsigned long)sample.rtt_ms);
     }
   }
+  socket.close();
 
-  if ((int)timestamp < 0) {
-    printf("An error occurred when getting the time. (code %u)\n", timestamp);
-    sync_rtc_with_factory();
-  } else {
-    printf("> Synced RTC to %s", ctime(&timestamp));
-    set_time(timestamp);
+  int answers = query.answers;
+  ntp_sample_t best;
+  int kept = ntp_select(query.samples, answers,
+                        MBED_CONF_APP_NTP_MAX_DEVIATION_MS, &best);
+  if (!kept) {
+    printf("An error occurred when getting the time. (%d of %d answered)\n",
+           answers, query.requests);
+    return -1;
   }
+  if (!ntp_query_done(&query)) {
+    printf("> Only %d of %d NTP servers answered\n", answers,
+           query.requests);
+  }
+
+  *offset_ms = best.offset_ms;
+  printf("> Used %d of %d answers, round trip %lu ms, took %lld ms\n", kept,
+         answers, (unsigned long)best.rtt_ms,
+         duration_cast<milliseconds>(timer.elapsed_time()).count());
+  return 0;
 }
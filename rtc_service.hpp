@@ -10,8 +10,45 @@
 #ifndef RTC_SERVICE_H
 #define RTC_SERVICE_H
 
+#include "datastore.hpp"
 #include "mbed.h"
-#include "ntp-client/NTPClient.h"
+#include "ntp.hpp"
+
+#define RTC_MODEL_MAGIC 0x4B4C4352 // "RCLK"
+
+/**
+ * @brief What is known about the RTC, as it is stored in flash.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t last_sync;   // Unix time the RTC was last set from NTP
+  int32_t drift_ppb;    // Rate the RTC gains time at, in parts per billion
+  uint32_t drift_syncs; // Number of syncs the drift was learned from
+  uint32_t crc;
+} rtc_model_t;
+
+/**
+ * @brief Loads the RTC model from flash.
+ *
+ * @return 0 upon success, -1 if there is no valid model.
+ */
+int load_rtc_model();
+
+/**
+ * @brief Predicts how far the RTC is from the true time.
+ *
+ * @return The predicted error in milliseconds, UINT32_MAX if the RTC has not
+ * been synced since it last lost power.
+ */
+uint32_t rtc_predicted_error_ms();
+
+/**
+ * @brief Returns how long the RTC can run before its predicted error passes
+ * rtc-max-error-ms.
+ *
+ * @return The time in milliseconds, 0 if the RTC needs a sync now.
+ */
+uint32_t rtc_ms_until_resync();
 
 /**
  * @brief Synchronizes the RTC to a hardcoded epoch.
@@ -21,15 +58,33 @@
 void sync_rtc_with_factory();
 
 /**
- * @brief Synchronizes the RTC to the epoch returned by
- *        the default NTP server.
+ * @brief Queries the NTP servers in the ntp-servers option for the time.
  *
- * The default NTP server is 2.pool.ntp.org port 123.
+ * Every server is queried at once. The query finishes once ntp-quorum servers
+ * have answered or ntp-timeout-ms has passed. Answers further than
+ * ntp-max-deviation-ms from the median are rejected and the remaining answer
+ * with the shortest round trip is used, compensated for half of it.
  *
- * @return Void.
+ * @param wifi The network to query over.
+ * @param offset_ms Set to the Unix time in ms less the kernel clock.
+ * @return 0 upon success, -1 if no server answered.
  *
  * Precondition: wifi connection has been established.
  */
-void sync_rtc_with_ntp(NetworkInterface *wifi);
+int query_ntp(NetworkInterface *wifi, int64_t *offset_ms);
+
+/**
+ * @brief Corrects the RTC to the true time. How far the RTC had drifted since
+ * the last sync updates the stored drift rate. The network is not needed.
+ *
+ * When slewing, errors up to rtc-slew-max-ms are removed one second every
+ * rtc-slew-interval-ms, which can take minutes. Larger errors, and RTCs that
+ * lost power, are stepped.
+ *
+ * @param offset_ms The Unix time in ms less the kernel clock.
+ * @param slew Whether to slew rather than step the RTC.
+ * @return The correction applied in milliseconds.
+ */
+int64_t correct_rtc(int64_t offset_ms, bool slew);
 
 #endif // RTC_SERVICE_H
@@ -9,52 +9,137 @@
  */
 #include "smartlock.hpp"
 
-SmartLock::SmartLock(EventQueue *event_queue)
-    : _lock_state(SmartLock::LOCKED), _event_queue(event_queue), _out_pin(D7),
-      _led1(LED1), _led2(LED2) {
-  _out_pin = 0.0f;
+/**
+ * @brief LED1 blinks twice on lock.
+ */
+static const led_step_t LOCK_PATTERN[] = {
+    {LED_PATTERN_LED1, 300}, {0, 150}, {LED_PATTERN_LED1, 300}, {0, 150}};
+
+/**
+ * @brief LED2 stays on while LED1 blinks twice on unlock.
+ */
+static const led_step_t UNLOCK_PATTERN[] = {
+    {LED_PATTERN_LED1 | LED_PATTERN_LED2, 300},
+    {LED_PATTERN_LED2, 150},
+    {LED_PATTERN_LED1 | LED_PATTERN_LED2, 300}};
 
-  printf("> SmartLock initialized to LOCKED\n");
+static queue_site_t relock_site = QUEUE_SITE("relock");
+
+SmartLock::SmartLock(ProfiledEventQueue *event_queue,
+                     const lock_config_t &config, int index)
+    : _lock_state(SmartLock::LOCKED), _event_queue(event_queue),
+      _index(index), _actuator(event_queue, config.out_pin,
+                &DRIVE_PROFILES[config.profile]),
+      _leds(event_queue, config.led1, config.led2), _user_count(0),
+      _relock_delay(MBED_CONF_APP_RELOCK_DELAY_MS), _relock_event(0) {
+  _user_count = get_lock_users(index, _users, LOCK_MAX_USERS);
+  if (_user_count < 0) {
+    _user_count = 0;
+  }
+  // A strike closes once its output is released, whatever the lock state
+  _actuator.on_release(callback(this, &SmartLock::_on_actuator_release));
+
+  printf("> SmartLock %d initialized to LOCKED (%d users)\n", _index,
+         _user_count);
 }
 
 void SmartLock::lock() {
+  _cancel_relock();
   _update_state(SmartLock::LOCKED);
-  printf("> SmartLock LOCKED\n");
-
-  for (int i = 0; i < 2; i++) {
-    _led1 = 1;
-    thread_sleep_for(300);
-    _led1 = 0;
-    thread_sleep_for(150);
-  }
+  printf("> SmartLock %d LOCKED\n", _index);
+  _leds.play(LOCK_PATTERN, sizeof(LOCK_PATTERN) / sizeof(LOCK_PATTERN[0]));
 }
 
 void SmartLock::unlock() {
+  TRACE_SCOPE(TRACE_UNLOCK, _index);
+  if (_lock_state == SmartLock::HELD_OPEN) {
+    return;
+  }
+  _schedule_relock();
+  if (_lock_state == SmartLock::UNLOCKED) {
+    return;
+  }
+
   _update_state(SmartLock::UNLOCKED);
-  printf("> SmartLock UNLOCKED\n");
-
-  _led2 = 1;
-  for (int i = 0; i < 2; i++) {
-    _led1 = 1;
-    thread_sleep_for(300);
-    _led1 = 0;
-    if (i < 1) {
-      thread_sleep_for(150);
-    }
+  printf("> SmartLock %d UNLOCKED\n", _index);
+  _leds.play(UNLOCK_PATTERN,
+             sizeof(UNLOCK_PATTERN) / sizeof(UNLOCK_PATTERN[0]));
+}
+
+void SmartLock::extend_relock() {
+  if (_lock_state == SmartLock::UNLOCKED) {
+    _schedule_relock();
+  }
+}
+
+void SmartLock::hold_open() {
+  _cancel_relock();
+  if (_lock_state == SmartLock::LOCKED) {
+    _leds.play(UNLOCK_PATTERN,
+               sizeof(UNLOCK_PATTERN) / sizeof(UNLOCK_PATTERN[0]));
   }
-  _led2 = 0;
+  _update_state(SmartLock::HELD_OPEN);
+  printf("> SmartLock %d HELD OPEN\n", _index);
+}
+
+void SmartLock::set_relock_delay(std::chrono::milliseconds delay) {
+  _relock_delay = delay;
+}
+
+uint64_t SmartLock::driven_at() { return _actuator.driven_at(); }
+
+bool SmartLock::is_unlocked() { return _lock_state != SmartLock::LOCKED; }
 
-  _event_queue->call_in(7500ms, this, &SmartLock::lock);
+bool SmartLock::is_authorized(const char *identity) {
+  if (_user_count == 0) {
+    return true;
+  }
+  if (!identity[0]) {
+    return false;
+  }
+  for (int i = 0; i < _user_count; i++) {
+    if (strcmp(_users[i], identity) == 0) {
+      return true;
+    }
+  }
+  return false;
 }
 
-bool SmartLock::is_unlocked() { return _lock_state == SmartLock::UNLOCKED; }
+int SmartLock::index() { return _index; }
 
 void SmartLock::_update_state(lock_state_t new_state) {
+  lock_state_t old_state = _lock_state;
   _lock_state = new_state;
 
-  if (new_state == SmartLock::UNLOCKED) {
-    _out_pin = 1.0f;
-  } else {
-    _out_pin = 0.0f;
+  if (new_state == SmartLock::LOCKED) {
+    _actuator.release();
+  } else if (old_state == SmartLock::LOCKED) {
+    _actuator.energize();
+  }
+}
+
+void SmartLock::_schedule_relock() {
+  _cancel_relock();
+  _relock_event =
+      _event_queue->call_in(&relock_site, _relock_delay, this,
+                            &SmartLock::_relock);
+}
+
+void SmartLock::_cancel_relock() {
+  if (_relock_event) {
+    _event_queue->cancel(_relock_event);
+    _relock_event = 0;
+  }
+}
+
+void SmartLock::_relock() {
+  _relock_event = 0;
+  lock();
+}
+
+void SmartLock::_on_actuator_release() {
+  if (_lock_state != SmartLock::LOCKED) {
+    printf("> SmartLock %d actuator released\n", _index);
+    lock();
   }
 }
@@ -10,33 +10,87 @@
 #ifndef SMARTLOCK_H
 #define SMARTLOCK_H
 
+#include "actuator.hpp"
+#include "datastore.hpp"
+#include "led_pattern.hpp"
 #include "mbed.h"
+#include "profiled_event_queue.hpp"
+#include "trace.hpp"
+#include <chrono>
+
+#define LOCK_MAX_USERS 8
+
+/**
+ * @brief The pins wired to a single lock.
+ */
+typedef struct {
+  PinName out_pin;            // Actuator output
+  PinName led1;               // Status LED, NC if none
+  PinName led2;               // Status LED, NC if none
+  drive_profile_id_t profile; // How the actuator is driven
+} lock_config_t;
 
 class SmartLock {
 public:
-  enum lock_state_t { LOCKED, UNLOCKED };
+  enum lock_state_t { LOCKED, UNLOCKED, HELD_OPEN };
 
   /**
    * @brief Construct a new SmartLock object.
    *
+   * @param event_queue The queue that runs relocks and LED patterns.
+   * @param config The pins wired to the lock.
+   * @param index The address of the lock within its bank.
    * @return Instance of SmartLock.
    */
-  SmartLock(events::EventQueue *event_queue);
+  SmartLock(ProfiledEventQueue *event_queue, const lock_config_t &config,
+            int index);
 
   /**
-   * @brief Lock the Smart Lock and update states.
+   * @brief Lock the Smart Lock, cancel any pending relock and update states.
    *
    * @return Void.
    */
   void lock();
 
   /**
-   * @brief Unlock the Smart Lock and update states.
+   * @brief Unlock the Smart Lock and update states. The lock relocks itself
+   * after the relock delay; unlocking again restarts the delay.
    *
    * @return Void.
    */
   void unlock();
 
+  /**
+   * @brief Restart the relock delay of an unlocked Smart Lock.
+   *
+   * @return Void.
+   */
+  void extend_relock();
+
+  /**
+   * @brief Unlock the Smart Lock and keep it unlocked until lock() is called,
+   * or until a drive profile with a release time releases the actuator.
+   *
+   * @return Void.
+   */
+  void hold_open();
+
+  /**
+   * @brief Set how long the Smart Lock stays unlocked. Takes effect the next
+   * time the relock is scheduled.
+   *
+   * @param delay The relock delay.
+   * @return Void.
+   */
+  void set_relock_delay(std::chrono::milliseconds delay);
+
+  /**
+   * @brief Returns when the actuator output last changed.
+   *
+   * @return The time in microseconds of the us ticker.
+   */
+  uint64_t driven_at();
+
   /**
    * @brief Returns true if the SmartLock is unlocked.
    *
@@ -44,12 +98,33 @@ public:
    */
   bool is_unlocked();
 
+  /**
+   * @brief Returns true if a device may open the Smart Lock. A lock without
+   * authorized users can be opened by any device.
+   *
+   * @param identity The identity address of a bonded device on an
+   * authenticated link, empty for any other device.
+   * @return true if condition holds, false otherwise.
+   */
+  bool is_authorized(const char *identity);
+
+  /**
+   * @brief Returns the address of the Smart Lock within its bank.
+   *
+   * @return The index of the lock.
+   */
+  int index();
+
 private:
   lock_state_t _lock_state;
-  EventQueue *_event_queue;
-  AnalogOut _out_pin;
-  DigitalOut _led1;
-  DigitalOut _led2;
+  ProfiledEventQueue *_event_queue;
+  int _index;
+  Actuator _actuator;
+  LedPattern _leds;
+  char _users[LOCK_MAX_USERS][DEVICE_ADDRESS_LENGTH + 1];
+  int _user_count;
+  std::chrono::milliseconds _relock_delay;
+  int _relock_event;
 
   /**
    * @brief Update the state of the Smart Lock.
@@ -57,6 +132,35 @@ private:
    * @return Void.
    */
   void _update_state(lock_state_t new_state);
+
+  /**
+   * @brief Replace the pending relock with one after the relock delay.
+   *
+   * @return Void.
+   */
+  void _schedule_relock();
+
+  /**
+   * @brief Cancel the pending relock, if any.
+   *
+   * @return Void.
+   */
+  void _cancel_relock();
+
+  /**
+   * @brief Lock once the relock delay has passed.
+   *
+   * @return Void.
+   */
+  void _relock();
+
+  /**
+   * @brief Lock once the drive profile has released the actuator, so the
+   * state matches the lock.
+   *
+   * @return Void.
+   */
+  void _on_actuator_release();
 };
 
 #endif // SMARTLOCK_H
@@ -0,0 +1,44 @@
+/**
+ * @file check.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines the checks used by the host tests.
+ * @bug No known bugs.
+ */
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+/**
+ * @brief Reports a failed check without stopping the test.
+ *
+ * @return Void.
+ */
+static inline void check(bool ok, const char *expression, const char *file,
+                         int line) {
+  if (!ok) {
+    printf("%s:%d: check failed: %s\n", file, line, expression);
+    check_failures++;
+  }
+}
+
+#define CHECK(expression) check((expression), #expression, __FILE__, __LINE__)
+
+/**
+ * @brief Prints the outcome of a test.
+ *
+ * @param name The name of the test.
+ * @return The exit status of the test.
+ */
+static inline int check_result(const char *name) {
+  printf("> %s: %s (%d failed)\n", name, check_failures ? "FAIL" : "OK",
+         check_failures);
+  return check_failures ? 1 : 0;
+}
+
+#endif // CHECK_H
@@ -0,0 +1,99 @@
+/**
+ * @file ntp_stand_in.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains a local UDP NTP server for the host tests. Its
+ * clock, network delays and health can be set per server.
+ * @bug No known bugs.
+ */
+#include "ntp_stand_in.hpp"
+#include "ntp.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std::chrono;
+
+int64_t host_unix_ms() {
+  return duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t host_monotonic_ms() {
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief Writes Unix time in milliseconds as an NTP timestamp.
+ *
+ * @return Void.
+ */
+static void write_timestamp(uint8_t *data, int64_t unix_ms) {
+  uint32_t seconds = (uint32_t)(unix_ms / 1000 + NTP_UNIX_OFFSET);
+  uint32_t fraction = (uint32_t)(((uint64_t)(unix_ms % 1000) << 32) / 1000);
+  for (int i = 0; i < 4; i++) {
+    data[i] = seconds >> (24 - 8 * i);
+    data[4 + i] = fraction >> (24 - 8 * i);
+  }
+}
+
+NtpStandIn::NtpStandIn(const ntp_stand_in_config_t &config)
+    : _config(config), _port(0) {
+  _socket = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (_socket < 0 ||
+      bind(_socket, (sockaddr *)&address, sizeof(address)) != 0 ||
+      getsockname(_socket, (sockaddr *)&address, &length) != 0) {
+    return;
+  }
+  _port = ntohs(address.sin_port);
+  _thread = std::thread(&NtpStandIn::_serve, this);
+}
+
+NtpStandIn::~NtpStandIn() {
+  if (_socket >= 0) {
+    shutdown(_socket, SHUT_RDWR);
+  }
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+  if (_socket >= 0) {
+    close(_socket);
+  }
+}
+
+uint16_t NtpStandIn::port() { return _port; }
+
+void NtpStandIn::_serve() {
+  uint8_t packet[NTP_PACKET_SIZE];
+  sockaddr_in client;
+  socklen_t length = sizeof(client);
+  while (recvfrom(_socket, packet, sizeof(packet), 0, (sockaddr *)&client,
+                  &length) == NTP_PACKET_SIZE) {
+    // The request spends the uplink delay on its way to the server
+    std::this_thread::sleep_for(milliseconds(_config.uplink_ms));
+    int64_t received = host_unix_ms() + _config.offset_ms;
+
+    uint8_t answer[NTP_PACKET_SIZE];
+    memset(answer, 0, sizeof(answer));
+    answer[0] = _config.stratum ? 0x1C : 0xDC; // Version 3, server mode
+    answer[1] = _config.stratum;
+    memcpy(answer + 24, packet + 40, 8); // Originate is the client transmit
+    write_timestamp(answer + 32, received);
+    write_timestamp(answer + 40, host_unix_ms() + _config.offset_ms);
+
+    std::this_thread::sleep_for(milliseconds(_config.downlink_ms));
+    sendto(_socket, answer, sizeof(answer), 0, (sockaddr *)&client, length);
+    length = sizeof(client);
+  }
+}
@@ -0,0 +1,76 @@
+/**
+ * @file ntp_stand_in.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines a local UDP NTP server for the host tests. Its
+ * clock, network delays and health can be set per server.
+ * @bug No known bugs.
+ */
+#ifndef NTP_STAND_IN_H
+#define NTP_STAND_IN_H
+
+#include <stdint.h>
+#include <thread>
+
+/**
+ * @brief How a stand-in server answers.
+ */
+typedef struct {
+  int64_t offset_ms;    // Server clock less the host clock
+  uint32_t uplink_ms;   // Delay before the request reaches the server
+  uint32_t downlink_ms; // Delay before the answer reaches the client
+  uint8_t stratum;      // 0 answers as an unsynchronized server
+} ntp_stand_in_config_t;
+
+class NtpStandIn {
+public:
+  /**
+   * @brief Construct a new NtpStandIn object and start serving on a free
+   * port of 127.0.0.1.
+   *
+   * @param config How the server answers.
+   * @return Instance of NtpStandIn.
+   */
+  NtpStandIn(const ntp_stand_in_config_t &config);
+
+  ~NtpStandIn();
+
+  /**
+   * @brief Returns the port the server listens on.
+   *
+   * @return The port, 0 if the server could not start.
+   */
+  uint16_t port();
+
+private:
+  ntp_stand_in_config_t _config;
+  int _socket;
+  uint16_t _port;
+  std::thread _thread;
+
+  /**
+   * @brief Answers requests until the socket is shut down.
+   *
+   * @return Void.
+   */
+  void _serve();
+};
+
+/**
+ * @brief Returns the host clock as Unix time in milliseconds.
+ *
+ * @return The Unix time in milliseconds.
+ */
+int64_t host_unix_ms();
+
+/**
+ * @brief Returns a monotonic clock in milliseconds, the local clock of the
+ * client.
+ *
+ * @return The monotonic time in milliseconds.
+ */
+uint64_t host_monotonic_ms();
+
+#endif // NTP_STAND_IN_H
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Builds and runs the host tests. Run from the repository root.
+set -e
+
+CXX=${CXX:-c++}
+BUILD=${BUILD:-_test_build}
+mkdir -p "$BUILD"
+
+build() {
+  name=$1
+  shift
+  $CXX -std=c++14 -O2 -Wall -Wextra -pthread -I. -Itests "$@" -o "$BUILD/$name"
+}
+
+build test_drive_profile tests/test_drive_profile.cpp drive_profile.cpp
+build test_ntp tests/test_ntp.cpp tests/ntp_stand_in.cpp ntp.cpp
+build test_qr_image tests/test_qr_image.cpp qr_image.cpp qr_matrix.cpp \
+  qrcodegen.cpp helpers.cpp
+build test_codec tests/test_codec.cpp codec.cpp
+tests="test_drive_profile test_ntp test_qr_image test_codec"
+# The codec has an SSSE3 path for host builds
+case $(uname -m) in
+x86_64 | i?86)
+  build test_codec_ssse3 -mssse3 tests/test_codec.cpp codec.cpp
+  tests="$tests test_codec_ssse3"
+  ;;
+esac
+
+status=0
+for test in $tests; do
+  "$BUILD/$test" || status=1
+done
+
+# The storage simulator needs the LittleFS v1 sources from `mbed deploy`
+LFS=${LFS:-mbed-os/storage/filesystem/littlefs/littlefs}
+if [ -f "$LFS/lfs.c" ]; then
+  ${CC:-cc} -O2 -c -I"$LFS" "$LFS/lfs.c" -o "$BUILD/lfs.o"
+  ${CC:-cc} -O2 -c -I"$LFS" "$LFS/lfs_util.c" -o "$BUILD/lfs_util.o"
+  build storage_sim -Itools/storage_sim -I"$LFS" tools/storage_sim/*.cpp \
+    datastore.cpp instrumented_block_device.cpp helpers.cpp codec.cpp \
+    "$BUILD/lfs.o" "$BUILD/lfs_util.o" \
+    -Wl,--wrap=fopen,--wrap=remove,--wrap=rename
+  if "$BUILD/storage_sim" -f "$BUILD/storage.bin" -n 200 --fresh &&
+    "$BUILD/storage_sim" -f "$BUILD/storage.bin" -n 200; then
+    echo "> storage sim: OK"
+  else
+    echo "> storage sim: FAILED"
+    status=1
+  fi
+else
+  echo "> storage sim: skipped, no LittleFS sources in $LFS (set LFS)"
+fi
+exit $status
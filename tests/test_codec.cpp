@@ -0,0 +1,120 @@
+/**
+ * @file test_codec.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host test of the hex and base32 codec. It is built with and without
+ * -mssse3, and both builds are checked against the RFC 4648 vectors and a
+ * bit-at-a-time base32 encoder for every length up to a few vector blocks.
+ * @bug No known bugs.
+ */
+#include "check.hpp"
+#include "codec.hpp"
+#include <string.h>
+
+#define MAX_LENGTH 64
+
+/**
+ * @brief Encodes base32 one bit at a time, as RFC 4648 describes it.
+ *
+ * @return Void.
+ */
+static void reference_base32(const uint8_t *bytes, size_t length,
+                             char *text) {
+  static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+  size_t bits = length * 8;
+  size_t count = 0;
+  for (size_t bit = 0; bit < bits; bit += 5) {
+    int value = 0;
+    for (size_t j = bit; j < bit + 5; j++) {
+      int set = j < bits && (bytes[j / 8] >> (7 - j % 8)) & 1;
+      value = value << 1 | set;
+    }
+    text[count++] = digits[value];
+  }
+  text[count] = '\0';
+}
+
+/**
+ * @brief Checks base32 encoding of a string against its RFC 4648 vector,
+ * without the padding.
+ *
+ * @return Void.
+ */
+static void check_base32_vector(const char *input, const char *expected) {
+  char text[32];
+  int length = bytes_to_base32((const uint8_t *)input, strlen(input), text,
+                               sizeof(text));
+  CHECK(length == (int)strlen(expected));
+  CHECK(strcmp(text, expected) == 0);
+}
+
+int main() {
+  check_base32_vector("", "");
+  check_base32_vector("f", "MY");
+  check_base32_vector("fo", "MZXQ");
+  check_base32_vector("foo", "MZXW6");
+  check_base32_vector("foob", "MZXW6YQ");
+  check_base32_vector("fooba", "MZXW6YTB");
+  check_base32_vector("foobar", "MZXW6YTBOI");
+  check_base32_vector("foobarbaz!", "MZXW6YTBOJRGC6RB");
+
+  // Every length, so each mix of vector blocks, groups and tail is covered
+  uint8_t bytes[MAX_LENGTH];
+  for (int i = 0; i < MAX_LENGTH; i++) {
+    bytes[i] = (uint8_t)(i * 151 + 17);
+  }
+  for (size_t length = 0; length <= MAX_LENGTH; length++) {
+    char expected[BASE32_LENGTH(MAX_LENGTH) + 1];
+    char text[BASE32_LENGTH(MAX_LENGTH) + 1];
+    reference_base32(bytes, length, expected);
+    int written = bytes_to_base32(bytes, length, text,
+                                  BASE32_LENGTH(length) + 1);
+    CHECK(written == (int)BASE32_LENGTH(length));
+    CHECK(strcmp(text, expected) == 0);
+
+    uint8_t decoded[MAX_LENGTH];
+    CHECK(base32_to_bytes(text, written, decoded, sizeof(decoded)) ==
+          (int)length);
+    CHECK(memcmp(decoded, bytes, length) == 0);
+
+    char hex[HEX_LENGTH(MAX_LENGTH) + 1];
+    CHECK(bytes_to_hex(bytes, length, hex, HEX_LENGTH(length) + 1) ==
+          (int)HEX_LENGTH(length));
+    CHECK(hex_to_bytes(hex, HEX_LENGTH(length), decoded, sizeof(decoded)) ==
+          (int)length);
+    CHECK(memcmp(decoded, bytes, length) == 0);
+  }
+
+  // All 32 digits, each in both halves of the vector lookup
+  const uint8_t all_digits[] = {0x00, 0x44, 0x32, 0x14, 0xC7,
+                                0x42, 0x54, 0xB6, 0x35, 0xCF,
+                                0x84, 0x65, 0x3A, 0x56, 0xD7,
+                                0xC6, 0x75, 0xBE, 0x77, 0xDF};
+  char text[BASE32_LENGTH(sizeof(all_digits)) + 1];
+  bytes_to_base32(all_digits, sizeof(all_digits), text, sizeof(text));
+  CHECK(strcmp(text, "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567") == 0);
+
+  // Buffers one byte short are refused
+  CHECK(bytes_to_base32(bytes, 10, text, BASE32_LENGTH(10)) == -1);
+  char hex[8];
+  CHECK(bytes_to_hex(bytes, 4, hex, HEX_LENGTH(4)) == -1);
+
+  // Decoding accepts either case and padding, and rejects other characters
+  uint8_t decoded[8];
+  CHECK(base32_to_bytes("mzxw6ytboi======", 16, decoded, sizeof(decoded)) ==
+        6);
+  CHECK(memcmp(decoded, "foobar", 6) == 0);
+  CHECK(base32_to_bytes("MZXW1", 5, decoded, sizeof(decoded)) == -1);
+  CHECK(hex_to_bytes("0aFf", 4, decoded, sizeof(decoded)) == 2);
+  CHECK(decoded[0] == 0x0A && decoded[1] == 0xFF);
+  CHECK(hex_to_bytes("0g", 2, decoded, sizeof(decoded)) == -1);
+  CHECK(hex_to_bytes("abc", 3, decoded, sizeof(decoded)) == -1);
+
+#if defined(__SSSE3__)
+  return check_result("codec (ssse3)");
+#else
+  return check_result("codec");
+#endif
+}
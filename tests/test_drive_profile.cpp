@@ -0,0 +1,101 @@
+/**
+ * @file test_drive_profile.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host test of the actuator waveforms. The actuator is stepped the way
+ * Actuator::_step() steps it, and the level and time of every transition are
+ * checked for each profile.
+ * @bug No known bugs.
+ */
+#include "check.hpp"
+#include "drive_profile.hpp"
+#include <math.h>
+
+#define MAX_STEPS 8
+
+/**
+ * @brief One change of the output level.
+ */
+typedef struct {
+  uint32_t time_ms;
+  float level;
+} transition_t;
+
+/**
+ * @brief Steps a profile from the moment it is energized, writing the level
+ * at every scheduled change, until the level no longer changes.
+ *
+ * @return The number of transitions, including the first write.
+ */
+static int simulate(const drive_profile_t *profile, transition_t *steps) {
+  uint32_t elapsed = 0;
+  int count = 0;
+  while (count < MAX_STEPS) {
+    steps[count].time_ms = elapsed;
+    steps[count].level = drive_level_at(profile, elapsed);
+    count++;
+    int32_t next = drive_next_change(profile, elapsed);
+    if (next < 0) {
+      break;
+    }
+    // Events never run early or go back in time
+    CHECK((uint32_t)next > elapsed);
+    elapsed = next;
+  }
+  return count;
+}
+
+static bool same_level(float a, float b) { return fabsf(a - b) < 1e-6f; }
+
+/**
+ * @brief Checks that a profile produces exactly the expected transitions.
+ *
+ * @return Void.
+ */
+static void check_waveform(const drive_profile_t *profile,
+                           const transition_t *expected, int count) {
+  transition_t steps[MAX_STEPS];
+  int steps_count = simulate(profile, steps);
+  CHECK(steps_count == count);
+  for (int i = 0; i < count && i < steps_count; i++) {
+    CHECK(steps[i].time_ms == expected[i].time_ms);
+    CHECK(same_level(steps[i].level, expected[i].level));
+  }
+}
+
+int main() {
+  // Logic level output, high until the lock is released
+  const transition_t full_power[] = {{0, 1.0f}};
+  check_waveform(&DRIVE_PROFILES[DRIVE_FULL_POWER], full_power, 1);
+  CHECK(same_level(drive_level_at(&DRIVE_PROFILES[DRIVE_FULL_POWER], 600000),
+                   1.0f));
+
+  // Held for as long as the lock is open
+  const transition_t solenoid[] = {{0, 1.0f}, {150, 0.35f}};
+  check_waveform(&DRIVE_PROFILES[DRIVE_SOLENOID], solenoid, 2);
+
+  const transition_t strike[] = {{0, 1.0f}, {200, 0.5f}, {3000, 0.0f}};
+  check_waveform(&DRIVE_PROFILES[DRIVE_STRIKE], strike, 3);
+
+  // Levels just either side of each edge
+  const drive_profile_t *solenoid_profile = &DRIVE_PROFILES[DRIVE_SOLENOID];
+  CHECK(same_level(drive_level_at(solenoid_profile, 149), 1.0f));
+  CHECK(same_level(drive_level_at(solenoid_profile, 150), 0.35f));
+  // Still held at the longest relock delay a command can set
+  CHECK(same_level(drive_level_at(solenoid_profile, 3600000), 0.35f));
+  CHECK(drive_next_change(solenoid_profile, 150) == -1);
+
+  // Release before the end of the pull-in pulse skips the hold level
+  const drive_profile_t short_release = {1.0f, 500, 0.4f, 300, 50};
+  const transition_t short_release_steps[] = {{0, 1.0f}, {300, 0.0f}};
+  check_waveform(&short_release, short_release_steps, 2);
+
+  // No pull-in pulse, held until released
+  const drive_profile_t hold_only = {1.0f, 0, 0.6f, 1000, 50};
+  const transition_t hold_only_steps[] = {{0, 0.6f}, {1000, 0.0f}};
+  check_waveform(&hold_only, hold_only_steps, 2);
+
+  return check_result("drive profile");
+}
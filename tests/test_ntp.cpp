@@ -0,0 +1,207 @@
+/**
+ * @file test_ntp.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host test of the NTP sync against local stand-in servers with
+ * injected delays. The client loop follows query_ntp() in rtc_service.cpp.
+ * @bug No known bugs.
+ */
+#include "check.hpp"
+#include "ntp.hpp"
+#include "ntp_stand_in.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_DEVIATION_MS 1000
+// Allowance for scheduling on a loaded host
+#define TOLERANCE_MS 15
+
+/**
+ * @brief Queries the stand-in servers at once and collects answers until the
+ * quorum is reached or the timeout passes.
+ *
+ * @return The time the sync took in milliseconds.
+ */
+static uint64_t run_sync(NtpStandIn **servers, int count, int quorum,
+                         uint32_t timeout_ms, ntp_query_t *query) {
+  uint64_t start = host_monotonic_ms();
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ntp_query_init(query, (uint32_t)start << 4, quorum);
+
+  uint8_t packet[NTP_PACKET_SIZE];
+  for (int i = 0; i < count; i++) {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(servers[i]->port());
+    ntp_query_request(query, i, packet);
+    uint64_t sent_ms = host_monotonic_ms();
+    if (sendto(fd, packet, sizeof(packet), 0, (sockaddr *)&address,
+               sizeof(address)) == NTP_PACKET_SIZE) {
+      ntp_query_sent(query, i, sent_ms);
+    }
+  }
+
+  while (!ntp_query_done(query)) {
+    int remaining = (int)(timeout_ms - (host_monotonic_ms() - start));
+    if (remaining <= 0) {
+      break;
+    }
+    pollfd poll_fd = {fd, POLLIN, 0};
+    if (poll(&poll_fd, 1, remaining) <= 0) {
+      break;
+    }
+    ssize_t length = recv(fd, packet, sizeof(packet), 0);
+    uint64_t received_ms = host_monotonic_ms();
+    if (length > 0) {
+      ntp_query_answer(query, packet, length, received_ms);
+    }
+  }
+  close(fd);
+  return host_monotonic_ms() - start;
+}
+
+/**
+ * @brief Returns the offset a perfect sync with a server would measure.
+ *
+ * @return Unix time in ms less the local clock.
+ */
+static int64_t true_offset(int64_t server_offset_ms) {
+  return host_unix_ms() - (int64_t)host_monotonic_ms() + server_offset_ms;
+}
+
+static bool near(int64_t value, int64_t expected, int64_t tolerance) {
+  return llabs(value - expected) <= tolerance;
+}
+
+/**
+ * @brief Answers that are short, for another request or from an
+ * unsynchronized server are rejected.
+ *
+ * @return Void.
+ */
+static void test_parse_rejects() {
+  uint8_t packet[NTP_PACKET_SIZE];
+  memset(packet, 0, sizeof(packet));
+  packet[0] = 0x1C;
+  packet[1] = 2;
+  packet[27] = 0x42; // Tag 0x42 in the originate timestamp
+  packet[32] = 0xE0; // Some time after 2019
+  packet[40] = 0xE0;
+  ntp_sample_t sample;
+  CHECK(ntp_parse_response(packet, sizeof(packet), 0x42, 0, 0, &sample) == 0);
+  CHECK(ntp_parse_response(packet, sizeof(packet) - 1, 0x42, 0, 0,
+                           &sample) == -1);
+  CHECK(ntp_parse_response(packet, sizeof(packet), 0x43, 0, 0, &sample) ==
+        -1);
+  packet[1] = 0;
+  CHECK(ntp_parse_response(packet, sizeof(packet), 0x42, 0, 0, &sample) ==
+        -1);
+  packet[1] = 2;
+  packet[0] = 0xDC; // Leap indicator 3, not synchronized
+  CHECK(ntp_parse_response(packet, sizeof(packet), 0x42, 0, 0, &sample) ==
+        -1);
+}
+
+/**
+ * @brief Symmetric delays cancel out, asymmetric ones skew the offset by half
+ * their difference.
+ *
+ * @return Void.
+ */
+static void test_rtt_compensation() {
+  ntp_stand_in_config_t config = {12345, 80, 80, 2};
+  NtpStandIn server(config);
+  NtpStandIn *servers[] = {&server};
+  ntp_query_t query;
+  run_sync(servers, 1, 1, 2000, &query);
+  CHECK(query.answers == 1);
+  CHECK(near(query.samples[0].offset_ms, true_offset(12345), TOLERANCE_MS));
+  CHECK(near(query.samples[0].rtt_ms, 160, 2 * TOLERANCE_MS));
+
+  ntp_stand_in_config_t skewed = {0, 0, 100, 2};
+  NtpStandIn skewed_server(skewed);
+  NtpStandIn *skewed_servers[] = {&skewed_server};
+  run_sync(skewed_servers, 1, 1, 2000, &query);
+  CHECK(query.answers == 1);
+  CHECK(near(query.samples[0].offset_ms, true_offset(0) - 50, TOLERANCE_MS));
+}
+
+/**
+ * @brief The sync ends once the quorum answers, without waiting for a slow
+ * server, and once every server asked has answered when they are fewer.
+ *
+ * @return Void.
+ */
+static void test_quorum() {
+  ntp_stand_in_config_t fast = {0, 10, 10, 2};
+  ntp_stand_in_config_t slow = {0, 10, 1500, 2};
+  NtpStandIn a(fast), b(fast), c(fast), d(slow);
+  NtpStandIn *servers[] = {&d, &a, &b, &c};
+  ntp_query_t query;
+  uint64_t elapsed = run_sync(servers, 4, 3, 3000, &query);
+  CHECK(query.requests == 4);
+  CHECK(query.answers == 3);
+  CHECK(ntp_query_done(&query));
+  CHECK(elapsed < 1000);
+
+  elapsed = run_sync(servers + 1, 2, 3, 3000, &query);
+  CHECK(query.answers == 2);
+  CHECK(ntp_query_done(&query));
+  CHECK(elapsed < 1000);
+
+  // An unsynchronized server never counts, so the sync times out
+  ntp_stand_in_config_t unsynced = {0, 10, 10, 0};
+  NtpStandIn e(unsynced);
+  NtpStandIn *mixed[] = {&a, &e};
+  elapsed = run_sync(mixed, 2, 2, 500, &query);
+  CHECK(query.answers == 1);
+  CHECK(!ntp_query_done(&query));
+  CHECK(elapsed >= 500);
+}
+
+/**
+ * @brief A server far from the median is rejected even though it has the
+ * shortest round trip.
+ *
+ * @return Void.
+ */
+static void test_median_rejection() {
+  ntp_stand_in_config_t close1 = {0, 30, 30, 2};
+  ntp_stand_in_config_t close2 = {20, 40, 40, 2};
+  ntp_stand_in_config_t close3 = {40, 50, 50, 2};
+  ntp_stand_in_config_t falseticker = {5000, 0, 0, 2};
+  NtpStandIn a(close1), b(close2), c(close3), d(falseticker);
+  NtpStandIn *servers[] = {&a, &b, &c, &d};
+  ntp_query_t query;
+  run_sync(servers, 4, 4, 3000, &query);
+  CHECK(query.answers == 4);
+
+  ntp_sample_t best;
+  int kept = ntp_select(query.samples, query.answers, MAX_DEVIATION_MS, &best);
+  CHECK(kept == 3);
+  // The shortest round trip of the survivors is the first server
+  CHECK(near(best.offset_ms, true_offset(0), TOLERANCE_MS));
+  CHECK(near(best.rtt_ms, 60, 2 * TOLERANCE_MS));
+
+  // Without a majority near the median nothing is trusted more than the rest
+  ntp_sample_t split[] = {{0, 10}, {5000, 10}};
+  kept = ntp_select(split, 2, MAX_DEVIATION_MS, &best);
+  CHECK(kept == 0);
+}
+
+int main() {
+  test_parse_rejects();
+  test_rtt_compensation();
+  test_quorum();
+  test_median_rejection();
+  return check_result("ntp");
+}
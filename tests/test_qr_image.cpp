@@ -0,0 +1,270 @@
+/**
+ * @file test_qr_image.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host test of the QR image writers. The PNG is taken apart chunk by
+ * chunk and its pixels compared with the PBM, and the SVG path is drawn back
+ * into modules and compared with the code.
+ * @bug No known bugs.
+ */
+#include "check.hpp"
+#include "helpers.hpp"
+#include "keys.hpp"
+#include "qr_image.hpp"
+#include "qr_matrix.hpp"
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+
+/**
+ * @brief The bytes a writer produced.
+ */
+typedef struct {
+  char *data;
+  size_t length;
+} output_t;
+
+/**
+ * @brief Runs a writer into memory.
+ *
+ * @return The return value of the writer.
+ */
+template <typename Writer> static int capture(output_t *output, Writer write) {
+  FILE *out = open_memstream(&output->data, &output->length);
+  int err = write(out);
+  fclose(out);
+  return err;
+}
+
+static uint32_t read_be32(const uint8_t *data) {
+  return (uint32_t)data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+}
+
+/**
+ * @brief Checks the PBM header and that every pixel matches its module.
+ *
+ * @return A pointer to the first pixel row.
+ */
+static const uint8_t *check_pbm(const qr_matrix_t *matrix, int scale,
+                                const output_t *pbm) {
+  int width = (matrix->size + 2 * QR_MATRIX_BORDER) * scale;
+  int row_bytes = (width + 7) / 8;
+  char header[32];
+  int header_length = snprintf(header, sizeof(header), "P4\n%d %d\n", width,
+                               width);
+  CHECK(pbm->length == (size_t)(header_length + row_bytes * width));
+  CHECK(memcmp(pbm->data, header, header_length) == 0);
+
+  const uint8_t *pixels = (const uint8_t *)pbm->data + header_length;
+  int mismatches = 0;
+  for (int y = 0; y < width; y++) {
+    const uint8_t *row = pixels + y * row_bytes;
+    for (int x = 0; x < row_bytes * 8; x++) {
+      bool dark = row[x >> 3] & (0x80 >> (x & 7));
+      bool module = x < width &&
+                    qr_matrix_get(matrix, x / scale - QR_MATRIX_BORDER,
+                                  y / scale - QR_MATRIX_BORDER);
+      mismatches += dark != module;
+    }
+  }
+  CHECK(mismatches == 0);
+  return pixels;
+}
+
+/**
+ * @brief Checks the PNG structure, checksums and that its pixels are the
+ * PBM rows inverted.
+ *
+ * @return Void.
+ */
+static void check_png(int width, const uint8_t *pbm_pixels,
+                      const output_t *png) {
+  static const uint8_t SIGNATURE[8] = {0x89, 'P',  'N',  'G',
+                                       '\r', '\n', 0x1A, '\n'};
+  const uint8_t *data = (const uint8_t *)png->data;
+  CHECK(png->length > sizeof(SIGNATURE));
+  CHECK(memcmp(data, SIGNATURE, sizeof(SIGNATURE)) == 0);
+
+  // Every chunk has a valid CRC, in the order IHDR, IDAT, IEND
+  const char *expected_types[] = {"IHDR", "IDAT", "IEND"};
+  const uint8_t *chunks[3] = {NULL};
+  uint32_t lengths[3] = {0};
+  size_t offset = sizeof(SIGNATURE);
+  int count = 0;
+  while (offset + 12 <= png->length && count < 3) {
+    uint32_t length = read_be32(data + offset);
+    if (offset + 12 + length > png->length) {
+      break;
+    }
+    CHECK(memcmp(data + offset + 4, expected_types[count], 4) == 0);
+    CHECK(crc32(data + offset + 4, 4 + length) ==
+          read_be32(data + offset + 8 + length));
+    chunks[count] = data + offset + 8;
+    lengths[count] = length;
+    offset += 12 + length;
+    count++;
+  }
+  CHECK(count == 3);
+  CHECK(offset == png->length);
+  if (count != 3) {
+    return;
+  }
+
+  // Width, height, bit depth 1, grayscale, deflate, no filter, no interlace
+  uint8_t ihdr[13] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0};
+  ihdr[2] = width >> 8;
+  ihdr[3] = width;
+  ihdr[6] = width >> 8;
+  ihdr[7] = width;
+  CHECK(lengths[0] == sizeof(ihdr));
+  CHECK(memcmp(chunks[0], ihdr, sizeof(ihdr)) == 0);
+  CHECK(lengths[2] == 0);
+
+  // A zlib header, one stored block per row and the Adler-32 of the rows
+  const uint8_t *idat = chunks[1];
+  CHECK((idat[0] & 0x0F) == 8);
+  CHECK((idat[0] << 8 | idat[1]) % 31 == 0);
+  int row_bytes = (width + 7) / 8;
+  uint32_t block_length = 1 + row_bytes;
+  CHECK(lengths[1] == 2 + width * (5 + block_length) + 4);
+  if (lengths[1] != 2 + width * (5 + block_length) + 4) {
+    return;
+  }
+  uint32_t a = 1;
+  uint32_t b = 0;
+  int mismatches = 0;
+  const uint8_t *block = idat + 2;
+  for (int y = 0; y < width; y++) {
+    CHECK(block[0] == (y == width - 1));
+    CHECK((uint32_t)(block[1] | block[2] << 8) == block_length);
+    CHECK((uint16_t)(block[3] | block[4] << 8) == (uint16_t)~block_length);
+    CHECK(block[5] == 0);
+    for (uint32_t i = 0; i < block_length; i++) {
+      a = (a + block[5 + i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    // Padding bits are outside the image and may differ
+    const uint8_t *pbm_row = pbm_pixels + y * row_bytes;
+    for (int x = 0; x < width; x++) {
+      uint8_t bit = 0x80 >> (x & 7);
+      mismatches += !(block[6 + (x >> 3)] & bit) != !!(pbm_row[x >> 3] & bit);
+    }
+    block += 5 + block_length;
+  }
+  CHECK(mismatches == 0);
+  CHECK(read_be32(block) == (b << 16 | a));
+}
+
+/**
+ * @brief Draws the SVG path back into modules and checks that it covers the
+ * dark modules exactly, with one rectangle per run.
+ *
+ * @return Void.
+ */
+static void check_svg(const qr_matrix_t *matrix, const output_t *svg) {
+  int width = matrix->size + 2 * QR_MATRIX_BORDER;
+  char view_box[48];
+  snprintf(view_box, sizeof(view_box), "viewBox=\"0 0 %d %d\"", width, width);
+  std::string text(svg->data, svg->length);
+  CHECK(text.find(view_box) != std::string::npos);
+  size_t path = text.find(" d=\"");
+  CHECK(path != std::string::npos);
+  if (path == std::string::npos) {
+    return;
+  }
+
+  static uint8_t drawn[QR_MATRIX_MAX_SIZE][QR_MATRIX_MAX_SIZE];
+  memset(drawn, 0, sizeof(drawn));
+  const char *p = text.c_str() + path + 4;
+  int overlaps = 0;
+  int adjacent = 0;
+  int x, y, length, back, consumed;
+  while (sscanf(p, "M%d %dh%dv1h-%dz%n", &x, &y, &length, &back,
+                &consumed) == 4) {
+    CHECK(length == back && length > 0);
+    x -= QR_MATRIX_BORDER;
+    y -= QR_MATRIX_BORDER;
+    CHECK(x >= 0 && y >= 0 && y < matrix->size && x + length <= matrix->size);
+    if (x < 0 || y < 0 || y >= matrix->size || x + length > matrix->size) {
+      return;
+    }
+    // Runs are maximal, so a run never touches another on its row
+    adjacent += (x > 0 && drawn[y][x - 1]) ||
+                (x + length < matrix->size && drawn[y][x + length]);
+    for (int i = x; i < x + length; i++) {
+      overlaps += drawn[y][i];
+      drawn[y][i] = 1;
+    }
+    p += consumed;
+  }
+  CHECK(strncmp(p, "\"/>", 3) == 0);
+  CHECK(overlaps == 0);
+  CHECK(adjacent == 0);
+
+  int mismatches = 0;
+  for (y = 0; y < matrix->size; y++) {
+    for (x = 0; x < matrix->size; x++) {
+      mismatches += (bool)drawn[y][x] != qr_matrix_get(matrix, x, y);
+    }
+  }
+  CHECK(mismatches == 0);
+}
+
+/**
+ * @brief Writes a code in every format and checks the images.
+ *
+ * @return Void.
+ */
+static void check_images(const char *text, int scale) {
+  qr_matrix_t matrix;
+  CHECK(qr_matrix_encode(&matrix, text) == 0);
+  int width = (matrix.size + 2 * QR_MATRIX_BORDER) * scale;
+
+  output_t pbm, png, svg;
+  CHECK(capture(&pbm, [&](FILE *out) {
+          return qr_image_write_pbm(&matrix, scale, out);
+        }) == 0);
+  CHECK(capture(&png, [&](FILE *out) {
+          return qr_image_write_png(&matrix, scale, out);
+        }) == 0);
+  CHECK(capture(&svg, [&](FILE *out) {
+          return qr_image_write_svg(&matrix, out);
+        }) == 0);
+
+  const uint8_t *pbm_pixels = check_pbm(&matrix, scale, &pbm);
+  check_png(width, pbm_pixels, &png);
+  check_svg(&matrix, &svg);
+  free(pbm.data);
+  free(png.data);
+  free(svg.data);
+}
+
+int main() {
+  char uri[sizeof(OTPAUTH_URI_FORMAT) + 64];
+  snprintf(uri, sizeof(uri), OTPAUTH_URI_FORMAT,
+           "JBSWY3DPEHPK3PXPJBSWY3DPEHPK3PXP");
+  // Scales that leave padding bits in the last byte of a row and that don't
+  for (int scale : {1, 3, 8, QR_IMAGE_MAX_SCALE}) {
+    check_images(uri, scale);
+  }
+  check_images("A", 1);
+
+  // Bad scales and empty codes write nothing
+  qr_matrix_t matrix;
+  CHECK(qr_matrix_encode(&matrix, uri) == 0);
+  output_t output;
+  CHECK(capture(&output, [&](FILE *out) {
+          return qr_image_write_png(&matrix, QR_IMAGE_MAX_SCALE + 1, out);
+        }) == -1);
+  CHECK(output.length == 0);
+  free(output.data);
+  matrix.size = 0;
+  CHECK(capture(&output, [&](FILE *out) {
+          return qr_image_write_svg(&matrix, out);
+        }) == -1);
+  CHECK(output.length == 0);
+  free(output.data);
+  return check_result("qr image");
+}
@@ -0,0 +1,136 @@
+/**
+ * @file time_service.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains the service that keeps the RTC synced in the
+ * background.
+ * @bug No known bugs.
+ */
+#include "time_service.hpp"
+
+using namespace std::chrono;
+
+static Thread time_thread(osPriorityLow, 2 * OS_STACK_SIZE, nullptr, "time");
+static WiFiInterface *time_wifi = NULL;
+static time_stats_t time_stats;
+static Timeout window_timeout;
+
+/**
+ * @brief Accepts only codes for the RTC time again. Runs from the timeout
+ * interrupt, so it only sets the window.
+ *
+ * @return Void.
+ */
+static void narrow_validation_window() { set_validation_window(1); }
+
+/**
+ * @brief Connects, queries NTP and disconnects.
+ *
+ * @param offset_ms Set to the Unix time in ms less the kernel clock.
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int fetch_time(int64_t *offset_ms) {
+  Timer timer;
+  timer.start();
+  time_stats.attempts++;
+
+  int status = connect_to_wifi(time_wifi);
+  boot_phase_end(BOOT_PHASE_WIFI);
+  if (status == 0) {
+    status = query_ntp(time_wifi, offset_ms);
+  }
+  boot_phase_end(BOOT_PHASE_NTP);
+  disconnect_from_wifi(time_wifi);
+
+  if (status < 0) {
+    time_stats.failures++;
+    return -1;
+  }
+  uint32_t latency =
+      duration_cast<milliseconds>(timer.elapsed_time()).count();
+  time_stats.last_latency_ms = latency;
+  time_stats.total_latency_ms += latency;
+  if (latency > time_stats.max_latency_ms) {
+    time_stats.max_latency_ms = latency;
+  }
+  return 0;
+}
+
+/**
+ * @brief Syncs the RTC on schedule, forever. Falls back to the factory time
+ * once if the RTC lost power and cannot be synced.
+ *
+ * @return Void.
+ */
+static void run_time_service() {
+  bool defaulted = false;
+  while (true) {
+    uint32_t wait_ms = rtc_ms_until_resync();
+    if (wait_ms > MBED_CONF_APP_TIME_RESYNC_MAX_S * 1000ULL) {
+      wait_ms = MBED_CONF_APP_TIME_RESYNC_MAX_S * 1000;
+    }
+    if (wait_ms > 0) {
+      printf("> Next RTC sync in %lu s\n", (unsigned long)(wait_ms / 1000));
+      ThisThread::sleep_for(milliseconds(wait_ms));
+    }
+
+    int64_t offset_ms;
+    if (fetch_time(&offset_ms) < 0) {
+      if (rtc_predicted_error_ms() == UINT32_MAX && !defaulted) {
+        sync_rtc_with_factory();
+        defaulted = true;
+        // The factory time is far from any client clock, so a wide window
+        // would only accept more guesses
+        window_timeout.detach();
+        narrow_validation_window();
+      }
+      ThisThread::sleep_for(milliseconds(MBED_CONF_APP_RTC_RETRY_MS));
+      continue;
+    }
+
+    // Codes keep validating while the RTC slews, so the wide window stays
+    // until it is done
+    int64_t correction = correct_rtc(offset_ms, true);
+    window_timeout.detach();
+    narrow_validation_window();
+    time_stats.last_correction_ms = correction;
+    if (llabs(correction) > llabs(time_stats.max_correction_ms)) {
+      time_stats.max_correction_ms = correction;
+    }
+  }
+}
+
+void start_time_service(WiFiInterface *wifi) {
+  time_wifi = wifi;
+  load_rtc_model();
+  uint32_t rtc_error = rtc_predicted_error_ms();
+  if (rtc_error < MBED_CONF_APP_RTC_MAX_ERROR_MS) {
+    printf("> RTC trusted, predicted error %lu ms\n", (unsigned long)rtc_error);
+  } else {
+    set_validation_window(MBED_CONF_APP_UNSYNCED_TOTP_WINDOW);
+    // Closes the window even if NTP never answers
+    window_timeout.attach(narrow_validation_window,
+                          milliseconds(MBED_CONF_APP_UNSYNCED_TOTP_WINDOW_MS));
+  }
+  time_thread.start(run_time_service);
+}
+
+void print_time_stats() {
+  printf("> RTC syncs: %lu attempted, %lu failed\n",
+         (unsigned long)time_stats.attempts,
+         (unsigned long)time_stats.failures);
+  uint32_t synced = time_stats.attempts - time_stats.failures;
+  if (synced) {
+    printf("> Sync latency: last %lu ms, mean %lu ms, max %lu ms\n",
+           (unsigned long)time_stats.last_latency_ms,
+           (unsigned long)(time_stats.total_latency_ms / synced),
+           (unsigned long)time_stats.max_latency_ms);
+    printf("> RTC correction: last %lld ms, largest %lld ms\n",
+           (long long)time_stats.last_correction_ms,
+           (long long)time_stats.max_correction_ms);
+  }
+  printf("> Predicted RTC error: %lu ms\n",
+         (unsigned long)rtc_predicted_error_ms());
+}
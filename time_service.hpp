@@ -0,0 +1,53 @@
+/**
+ * @file time_service.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines the service that keeps the RTC synced in the
+ * background.
+ * @bug No known bugs.
+ */
+#ifndef TIME_SERVICE_H
+#define TIME_SERVICE_H
+
+#include "boot_profile.hpp"
+#include "mbed.h"
+#include "rtc_service.hpp"
+#include "totp.hpp"
+#include "wifi_service.hpp"
+
+/**
+ * @brief The results of the syncs made since boot.
+ */
+typedef struct {
+  uint32_t attempts;
+  uint32_t failures;
+  uint32_t last_latency_ms; // Connect and query time of the last sync
+  uint32_t max_latency_ms;
+  uint64_t total_latency_ms;
+  int64_t last_correction_ms;
+  int64_t max_correction_ms; // Largest correction by magnitude
+} time_stats_t;
+
+/**
+ * @brief Starts the low priority thread that syncs the RTC whenever its
+ * predicted error passes rtc-max-error-ms, and at least every
+ * time-resync-max-s. The network is connected only while querying NTP.
+ *
+ * Until the RTC is known to be right, TOTP codes are validated within
+ * unsynced-totp-window steps.
+ *
+ * @param wifi The network to sync over.
+ * @return Void.
+ */
+void start_time_service(WiFiInterface *wifi);
+
+/**
+ * @brief Prints the sync latency and the corrections applied since boot.
+ *
+ * @return Void.
+ */
+void print_time_stats();
+
+#endif // TIME_SERVICE_H
@@ -0,0 +1,612 @@
+/**
+ * @file provision.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host tool that provisions SmartLocks in bulk.
+ * For every device it generates the private key and recovery keys, writes the
+ * enrollment QR code as an image, and builds a LittleFS image holding the
+ * keystore that is flashed onto the QSPI flash. Devices are spread over a pool
+ * of threads, each reading its own random stream. Images are checked by
+ * mounting them through the storage simulator's LittleFileSystem, configured
+ * from the firmware's lfs-* options and the QSPI flash geometry.
+ *
+ * @bug No known bugs.
+ */
+#include "LittleFileSystem.h"
+#include "codec.hpp"
+#include "helpers.hpp"
+#include "keys.hpp"
+#include "mbed_config.h"
+#include "qr_image.hpp"
+#include "qr_matrix.hpp"
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define SERIAL_MAX_LEN 32
+#define PATH_MAX_LEN 256
+#define RANDOM_BUFFER_SIZE 4096
+// Geometry of the MX25R6435F QSPI flash as QSPIFBlockDevice reports it
+#define QSPIF_READ_SIZE 1
+#define QSPIF_PROGRAM_SIZE 1
+#define QSPIF_ERASE_SIZE 4096
+
+/**
+ * @brief The options given on the command line. Flash geometry defaults match
+ * the QSPI flash of the DISCO_L475VG_IOT01A and the lfs-* options in
+ * mbed_app.json, and must be kept in step with them.
+ */
+typedef struct {
+  int count;
+  int first;
+  int jobs;
+  int scale;
+  const char *prefix;
+  const char *out_dir;
+  const char *format;
+  bool manifest;
+  uint32_t flash_size;
+  uint32_t read_size;
+  uint32_t prog_size;
+  uint32_t block_size;
+  uint32_t lookahead;
+} options_t;
+
+/**
+ * @brief The keys generated for one device, kept for the manifest.
+ */
+typedef struct {
+  char serial[SERIAL_MAX_LEN];
+  char secret[BASE32_LENGTH(PRIVATE_KEY_SIZE) + 1];
+  char recovery_keys[RECOVERY_KEY_LENGTH + 1];
+  int err;
+} device_t;
+
+/**
+ * @brief A random stream owned by one worker, buffered so workers rarely
+ * enter the kernel and never share a lock.
+ */
+typedef struct {
+  FILE *source;
+  char buffer[RANDOM_BUFFER_SIZE];
+} rng_t;
+
+/**
+ * @brief A flash image in RAM that LittleFS formats and writes to.
+ */
+typedef struct {
+  uint8_t *data;
+  uint32_t block_size;
+  uint32_t used_blocks; // Blocks past the last one touched are still erased
+} ram_bd_t;
+
+static options_t options = {
+    0,               // count
+    1,               // first
+    0,               // jobs, one per core
+    8,               // scale
+    "SL",            // prefix
+    "provision",     // out_dir
+    "png",           // format
+    false,           // manifest
+    8 * 1024 * 1024, // flash_size
+    64,              // read_size
+    64,              // prog_size
+    4096,            // block_size
+    2048             // lookahead
+};
+
+/**
+ * @brief Opens a random stream with a buffer of its own.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int rng_open(rng_t *rng) {
+  rng->source = fopen("/dev/urandom", "rb");
+  if (!rng->source) {
+    return -1;
+  }
+  setvbuf(rng->source, rng->buffer, _IOFBF, sizeof(rng->buffer));
+  return 0;
+}
+
+/**
+ * @brief Reads random bytes from a stream.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int rng_read(rng_t *rng, uint8_t *buf, size_t length) {
+  return fread(buf, 1, length, rng->source) == length ? 0 : -1;
+}
+
+/**
+ * @brief Marks a block as touched, so it is kept in the image file.
+ *
+ * @return Void.
+ */
+static void ram_bd_touch(ram_bd_t *bd, lfs_block_t block) {
+  if (block + 1 > bd->used_blocks) {
+    bd->used_blocks = block + 1;
+  }
+}
+
+static int ram_bd_read(const struct lfs_config *c, lfs_block_t block,
+                       lfs_off_t off, void *buffer, lfs_size_t size) {
+  ram_bd_t *bd = (ram_bd_t *)c->context;
+  memcpy(buffer, bd->data + block * bd->block_size + off, size);
+  return 0;
+}
+
+static int ram_bd_prog(const struct lfs_config *c, lfs_block_t block,
+                       lfs_off_t off, const void *buffer, lfs_size_t size) {
+  ram_bd_t *bd = (ram_bd_t *)c->context;
+  memcpy(bd->data + block * bd->block_size + off, buffer, size);
+  ram_bd_touch(bd, block);
+  return 0;
+}
+
+static int ram_bd_erase(const struct lfs_config *c, lfs_block_t block) {
+  ram_bd_t *bd = (ram_bd_t *)c->context;
+  // The QSPI flash erases to 0xFF
+  memset(bd->data + block * bd->block_size, 0xFF, bd->block_size);
+  ram_bd_touch(bd, block);
+  return 0;
+}
+
+static int ram_bd_sync(const struct lfs_config *) { return 0; }
+
+/**
+ * @brief A flash image in RAM seen as the QSPI flash, so the image is mounted
+ * with the geometry the firmware's block device reports.
+ */
+class ImageBlockDevice : public mbed::BlockDevice {
+public:
+  /**
+   * @brief Construct a new ImageBlockDevice object.
+   *
+   * @param bd The flash image.
+   * @param size The size of the flash in bytes.
+   * @return Instance of ImageBlockDevice.
+   */
+  ImageBlockDevice(ram_bd_t *bd, bd_size_t size) : _bd(bd), _size(size) {}
+
+  virtual int init() { return 0; }
+  virtual int deinit() { return 0; }
+
+  virtual int read(void *buffer, bd_addr_t addr, bd_size_t size) {
+    memcpy(buffer, _bd->data + addr, size);
+    return 0;
+  }
+
+  virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size) {
+    memcpy(_bd->data + addr, buffer, size);
+    _touch(addr + size);
+    return 0;
+  }
+
+  virtual int erase(bd_addr_t addr, bd_size_t size) {
+    memset(_bd->data + addr, 0xFF, size);
+    _touch(addr + size);
+    return 0;
+  }
+
+  virtual bd_size_t get_read_size() const { return QSPIF_READ_SIZE; }
+  virtual bd_size_t get_program_size() const { return QSPIF_PROGRAM_SIZE; }
+  virtual bd_size_t get_erase_size() const { return QSPIF_ERASE_SIZE; }
+  virtual int get_erase_value() const { return 0xFF; }
+  virtual bd_size_t size() const { return _size; }
+  virtual const char *get_type() const { return "QSPIF"; }
+
+private:
+  ram_bd_t *_bd;
+  bd_size_t _size;
+
+  /**
+   * @brief Marks the blocks before an address as no longer erased.
+   *
+   * @return Void.
+   */
+  void _touch(bd_addr_t end) {
+    uint32_t blocks = (end + _bd->block_size - 1) / _bd->block_size;
+    if (blocks > _bd->used_blocks) {
+      _bd->used_blocks = blocks;
+    }
+  }
+};
+
+/**
+ * @brief Builds the keystore record the firmware expects on first boot, as
+ * set_private_key() followed by set_recovery_keys() would leave it. The host
+ * and the Cortex-M4 are both little endian with the same alignment, so the
+ * record is written as is.
+ *
+ * @return Void.
+ */
+static void build_keystore(keystore_t *keystore, const uint8_t *key,
+                           const char *recovery_keys) {
+  memset(keystore, 0, sizeof(*keystore));
+  keystore->magic = KEYSTORE_MAGIC;
+  keystore->version = KEYSTORE_VERSION;
+  keystore->flags = KEYSTORE_HAS_PRIVATE_KEY | KEYSTORE_HAS_RECOVERY_KEYS;
+  memcpy(keystore->private_key, key, PRIVATE_KEY_SIZE);
+  memcpy(keystore->recovery_keys, recovery_keys, RECOVERY_KEY_LENGTH);
+  keystore->recovery_epoch = 1;
+  keystore->crc = crc32(keystore, offsetof(keystore_t, crc));
+}
+
+/**
+ * @brief Formats the image, writes the keystore into it and saves the used
+ * part of it to a file. Erased blocks at the end are left out, since the
+ * flash is erased before it is programmed.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int write_flash_image(ram_bd_t *bd, const struct lfs_config *config,
+                             const keystore_t *keystore, const char *path) {
+  memset(bd->data, 0xFF, (size_t)bd->used_blocks * bd->block_size);
+  bd->used_blocks = 0;
+
+  lfs_t lfs;
+  lfs_file_t file;
+  if (lfs_format(&lfs, config) || lfs_mount(&lfs, config)) {
+    return -1;
+  }
+  // The firmware mounts the file system on /fs
+  int err = lfs_file_open(&lfs, &file, "keystore.bin",
+                          LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+  if (!err) {
+    lfs_ssize_t written =
+        lfs_file_write(&lfs, &file, keystore, sizeof(*keystore));
+    err = lfs_file_close(&lfs, &file);
+    if (written != (lfs_ssize_t)sizeof(*keystore)) {
+      err = -1;
+    }
+  }
+  if (lfs_unmount(&lfs) || err) {
+    return -1;
+  }
+
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    return -1;
+  }
+  size_t size = (size_t)bd->used_blocks * bd->block_size;
+  size_t saved = fwrite(bd->data, 1, size, f);
+  return fclose(f) == 0 && saved == size ? 0 : -1;
+}
+
+/**
+ * @brief Loads a saved image back onto erased flash, mounts it with the
+ * firmware's configuration rather than the one that wrote it and checks that
+ * it holds the keystore.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int verify_flash_image(ram_bd_t *bd, LittleFileSystem *fs,
+                              const keystore_t *keystore, const char *path) {
+  size_t size = (size_t)bd->used_blocks * bd->block_size;
+  memset(bd->data, 0xFF, size);
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return -1;
+  }
+  size_t loaded = fread(bd->data, 1, size, f);
+  bool at_end = fgetc(f) == EOF;
+  fclose(f);
+  if (loaded != size || !at_end) {
+    return -1;
+  }
+
+  ImageBlockDevice flash(bd, options.flash_size);
+  if (fs->mount(&flash)) {
+    return -1;
+  }
+  // The firmware reads the keystore as /fs/keystore.bin
+  f = fs->open("keystore.bin", "rb");
+  bool match = false;
+  if (f) {
+    keystore_t stored;
+    // Read one byte more to catch a file longer than the record
+    match = fread(&stored, sizeof(stored), 1, f) == 1 && fgetc(f) == EOF &&
+            memcmp(&stored, keystore, sizeof(stored)) == 0;
+    match = fclose(f) == 0 && match;
+  }
+  return fs->unmount() == 0 && match ? 0 : -1;
+}
+
+/**
+ * @brief Writes the enrollment QR code in the chosen image format.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int write_qr_image(const qr_matrix_t *qr, const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    return -1;
+  }
+  int err;
+  if (strcmp(options.format, "svg") == 0) {
+    err = qr_image_write_svg(qr, f);
+  } else if (strcmp(options.format, "pbm") == 0) {
+    err = qr_image_write_pbm(qr, options.scale, f);
+  } else {
+    err = qr_image_write_png(qr, options.scale, f);
+  }
+  return fclose(f) == 0 && !err ? 0 : -1;
+}
+
+/**
+ * @brief Generates and writes out the keys of one device.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int provision_device(device_t *device, rng_t *rng, ram_bd_t *bd,
+                            const struct lfs_config *config,
+                            LittleFileSystem *fs) {
+  uint8_t key[PRIVATE_KEY_SIZE];
+  uint8_t random[RECOVERY_KEY_LENGTH];
+  if (rng_read(rng, key, sizeof(key)) ||
+      rng_read(rng, random, sizeof(random))) {
+    return -1;
+  }
+  format_recovery_keys(random, device->recovery_keys);
+  bytes_to_base32(key, PRIVATE_KEY_SIZE, device->secret,
+                  sizeof(device->secret));
+
+  char uri[sizeof(OTPAUTH_URI_FORMAT) + sizeof(device->secret)];
+  snprintf(uri, sizeof(uri), OTPAUTH_URI_FORMAT, device->secret);
+  qr_matrix_t qr;
+  if (qr_matrix_encode(&qr, uri) < 0) {
+    return -1;
+  }
+
+  char path[PATH_MAX_LEN];
+  snprintf(path, sizeof(path), "%s/%s.%s", options.out_dir, device->serial,
+           options.format);
+  if (write_qr_image(&qr, path) < 0) {
+    return -1;
+  }
+
+  keystore_t keystore;
+  build_keystore(&keystore, key, device->recovery_keys);
+  snprintf(path, sizeof(path), "%s/%s.lfs", options.out_dir, device->serial);
+  if (write_flash_image(bd, config, &keystore, path) < 0) {
+    return -1;
+  }
+  return verify_flash_image(bd, fs, &keystore, path);
+}
+
+/**
+ * @brief Provisions devices until none are left, with its own random stream,
+ * flash image and file system to check the images with.
+ *
+ * @return Void.
+ */
+static void worker(std::vector<device_t> *devices, std::atomic<int> *next,
+                   LittleFileSystem *fs) {
+  rng_t *rng = new rng_t;
+  ram_bd_t bd;
+  bd.block_size = options.block_size;
+  bd.used_blocks = options.flash_size / options.block_size;
+  bd.data = (uint8_t *)malloc(options.flash_size);
+
+  struct lfs_config config;
+  memset(&config, 0, sizeof(config));
+  config.context = &bd;
+  config.read = ram_bd_read;
+  config.prog = ram_bd_prog;
+  config.erase = ram_bd_erase;
+  config.sync = ram_bd_sync;
+  config.read_size = options.read_size;
+  config.prog_size = options.prog_size;
+  config.block_size = options.block_size;
+  config.block_count = options.flash_size / options.block_size;
+  config.lookahead = options.lookahead;
+  // LittleFileSystem limits the lookahead to the blocks it has
+  if (config.lookahead > config.block_count) {
+    config.lookahead = config.block_count - config.block_count % 32;
+  }
+
+  int err = bd.data && rng_open(rng) == 0 ? 0 : -1;
+  int index;
+  while ((index = next->fetch_add(1)) < (int)devices->size()) {
+    device_t *device = &(*devices)[index];
+    device->err =
+        err ? err : provision_device(device, rng, &bd, &config, fs);
+  }
+
+  if (rng->source) {
+    fclose(rng->source);
+  }
+  delete rng;
+  free(bd.data);
+}
+
+/**
+ * @brief Writes the keys of every device, one line each, for the label
+ * printer and the device records. Only the owner can read the file, as it
+ * holds every secret.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int write_manifest(const std::vector<device_t> &devices) {
+  char path[PATH_MAX_LEN];
+  snprintf(path, sizeof(path), "%s/manifest.csv", options.out_dir);
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  // An existing manifest keeps its mode, so it is narrowed as well
+  if (fd < 0 || fchmod(fd, 0600) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  FILE *f = fdopen(fd, "w");
+  if (!f) {
+    close(fd);
+    return -1;
+  }
+  fprintf(f, "serial,secret,recovery_keys\n");
+  for (const device_t &device : devices) {
+    fprintf(f, "%s,%s,", device.serial, device.secret);
+    for (int i = 0; i < RECOVERY_KEY_COUNT; i++) {
+      fprintf(f, "%s%.*s", i ? " " : "", RECOVERY_KEY_SIZE,
+              device.recovery_keys + i * RECOVERY_KEY_SIZE);
+    }
+    fprintf(f, "\n");
+  }
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Prints the command line options.
+ *
+ * @return Void.
+ */
+static void print_usage(const char *name) {
+  printf("Usage: %s -n COUNT [options]\n"
+         "  -n COUNT       Number of devices to provision\n"
+         "  -o DIR         Output directory (default provision)\n"
+         "  -j JOBS        Worker threads (default one per core)\n"
+         "  --first N      Number of the first device (default 1)\n"
+         "  --prefix STR   Serial number prefix (default SL)\n"
+         "  --format FMT   QR image format: png, svg or pbm (default png)\n"
+         "  --scale N      Pixels per QR module (default 8)\n"
+         "  --manifest     Write every secret and recovery key to\n"
+         "                 manifest.csv, readable by the owner only\n"
+         "  --flash-size N, --read-size N, --prog-size N, --block-size N,\n"
+         "  --lookahead N  Flash and LittleFS geometry, as in mbed_app.json\n",
+         name);
+}
+
+/**
+ * @brief Parses the command line into options.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int parse_options(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--manifest") == 0) {
+      options.manifest = true;
+      continue;
+    }
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (!value) {
+      return -1;
+    }
+    i++;
+    if (strcmp(arg, "-n") == 0) {
+      options.count = atoi(value);
+    } else if (strcmp(arg, "-o") == 0) {
+      options.out_dir = value;
+    } else if (strcmp(arg, "-j") == 0) {
+      options.jobs = atoi(value);
+    } else if (strcmp(arg, "--first") == 0) {
+      options.first = atoi(value);
+    } else if (strcmp(arg, "--prefix") == 0) {
+      options.prefix = value;
+    } else if (strcmp(arg, "--format") == 0) {
+      options.format = value;
+    } else if (strcmp(arg, "--scale") == 0) {
+      options.scale = atoi(value);
+    } else if (strcmp(arg, "--flash-size") == 0) {
+      options.flash_size = strtoul(value, NULL, 0);
+    } else if (strcmp(arg, "--read-size") == 0) {
+      options.read_size = strtoul(value, NULL, 0);
+    } else if (strcmp(arg, "--prog-size") == 0) {
+      options.prog_size = strtoul(value, NULL, 0);
+    } else if (strcmp(arg, "--block-size") == 0) {
+      options.block_size = strtoul(value, NULL, 0);
+    } else if (strcmp(arg, "--lookahead") == 0) {
+      options.lookahead = strtoul(value, NULL, 0);
+    } else {
+      return -1;
+    }
+  }
+
+  if (strcmp(options.format, "png") && strcmp(options.format, "svg") &&
+      strcmp(options.format, "pbm")) {
+    return -1;
+  }
+  if (options.count <= 0 || options.scale < 1 ||
+      options.scale > QR_IMAGE_MAX_SCALE || options.block_size == 0 ||
+      options.flash_size < 2 * options.block_size) {
+    return -1;
+  }
+  if (options.jobs <= 0) {
+    options.jobs = std::thread::hardware_concurrency();
+    if (options.jobs <= 0) {
+      options.jobs = 1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (parse_options(argc, argv) < 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  // The QR images hold the secrets too
+  if (mkdir(options.out_dir, 0700) != 0 && errno != EEXIST) {
+    printf("Cannot create %s: %s\n", options.out_dir, strerror(errno));
+    return 1;
+  }
+
+  std::vector<device_t> devices(options.count);
+  for (int i = 0; i < options.count; i++) {
+    snprintf(devices[i].serial, SERIAL_MAX_LEN, "%s%06d", options.prefix,
+             options.first + i);
+    devices[i].err = -1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  // Created up front, as file systems register themselves in a shared list
+  std::vector<LittleFileSystem *> file_systems;
+  for (int i = 0; i < options.jobs; i++) {
+    file_systems.push_back(new LittleFileSystem(
+        "image", NULL, MBED_CONF_APP_LFS_READ_SIZE, MBED_CONF_APP_LFS_PROG_SIZE,
+        MBED_CONF_APP_LFS_BLOCK_SIZE, MBED_CONF_APP_LFS_LOOKAHEAD));
+  }
+  std::atomic<int> next(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.jobs; i++) {
+    threads.emplace_back(worker, &devices, &next, file_systems[i]);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (LittleFileSystem *fs : file_systems) {
+    delete fs;
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  int failed = 0;
+  for (const device_t &device : devices) {
+    if (device.err) {
+      printf("> Failed to provision %s\n", device.serial);
+      failed++;
+    }
+  }
+  if (options.manifest && write_manifest(devices) < 0) {
+    printf("Cannot write the manifest\n");
+    return 1;
+  }
+  printf("> Provisioned %d devices in %.2f s on %d threads (%.0f devices/s)\n",
+         options.count - failed, seconds, options.jobs,
+         options.count / seconds);
+  return failed ? 1 : 0;
+}
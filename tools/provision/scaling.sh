@@ -0,0 +1,17 @@
+#!/bin/sh
+# Measures how the provisioning rate scales with the number of threads.
+# Usage: tools/provision/scaling.sh ./provision [COUNT]
+set -e
+PROVISION=${1:?Usage: $0 PROVISION [COUNT]}
+COUNT=${2:-2000}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+cores=$(nproc 2>/dev/null || echo 1)
+jobs=1
+while :; do
+  rm -rf "$OUT/run"
+  "$PROVISION" -n "$COUNT" -j "$jobs" -o "$OUT/run" | tail -n 1
+  [ "$jobs" -ge "$cores" ] && break
+  jobs=$((jobs * 2))
+  [ "$jobs" -gt "$cores" ] && jobs=$cores
+done
@@ -0,0 +1,118 @@
+/**
+ * @file qr_bench.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host benchmark of the QR code encoder and image writers. Enrollment
+ * URIs with distinct secrets are encoded, then written in every format to
+ * /dev/null, and the codes per second of each step are printed.
+ * @bug No known bugs.
+ */
+#include "keys.hpp"
+#include "qr_image.hpp"
+#include "qr_matrix.hpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define SECRET_LEN 32
+
+/**
+ * @brief Fills in an enrollment URI whose base32 secret is derived from the
+ * number of the code, so every code differs.
+ *
+ * @return Void.
+ */
+static void make_uri(int number, char *uri, size_t size) {
+  static const char BASE32[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+  char secret[SECRET_LEN + 1];
+  uint32_t state = 2166136261u ^ number;
+  for (int i = 0; i < SECRET_LEN; i++) {
+    state = state * 1664525u + 1013904223u;
+    secret[i] = BASE32[state >> 27];
+  }
+  secret[SECRET_LEN] = '\0';
+  snprintf(uri, size, OTPAUTH_URI_FORMAT, secret);
+}
+
+/**
+ * @brief Writes a code in one of the formats.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int write_image(int format, const qr_matrix_t *matrix, int scale,
+                       FILE *out) {
+  switch (format) {
+  case 0:
+    return qr_image_write_pbm(matrix, scale, out);
+  case 1:
+    return qr_image_write_png(matrix, scale, out);
+  default:
+    return qr_image_write_svg(matrix, out);
+  }
+}
+
+/**
+ * @brief Returns the size of the image a code is written to.
+ *
+ * @return The size in bytes.
+ */
+static size_t image_size(int format, const qr_matrix_t *matrix, int scale) {
+  char *data = NULL;
+  size_t size = 0;
+  FILE *out = open_memstream(&data, &size);
+  write_image(format, matrix, scale, out);
+  fclose(out);
+  free(data);
+  return size;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 2000;
+  int scale = argc > 2 ? atoi(argv[2]) : 8;
+  if (count <= 0 || scale < 1 || scale > QR_IMAGE_MAX_SCALE) {
+    printf("Usage: %s [COUNT] [SCALE]\n", argv[0]);
+    return 1;
+  }
+  FILE *out = fopen("/dev/null", "wb");
+  if (!out) {
+    printf("Cannot open /dev/null\n");
+    return 1;
+  }
+
+  std::vector<qr_matrix_t> matrices(count);
+  char uri[sizeof(OTPAUTH_URI_FORMAT) + SECRET_LEN];
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++) {
+    make_uri(i, uri, sizeof(uri));
+    if (qr_matrix_encode(&matrices[i], uri) < 0) {
+      printf("Cannot encode %s\n", uri);
+      return 1;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  printf("> %d codes of %d modules, scale %d\n", count, matrices[0].size,
+         scale);
+  printf("> encode %8.0f codes/s\n", count / elapsed.count());
+
+  static const char *const NAMES[] = {"pbm", "png", "svg"};
+  for (int format = 0; format < 3; format++) {
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+      if (write_image(format, &matrices[i], scale, out) < 0) {
+        printf("Cannot write %s\n", NAMES[format]);
+        return 1;
+      }
+    }
+    fflush(out);
+    elapsed = std::chrono::steady_clock::now() - start;
+    printf("> %-6s %8.0f codes/s %8zu bytes/code\n", NAMES[format],
+           count / elapsed.count(), image_size(format, &matrices[0], scale));
+  }
+  fclose(out);
+  return 0;
+}
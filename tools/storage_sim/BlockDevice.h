@@ -0,0 +1,59 @@
+/**
+ * @file BlockDevice.h
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host stand-in for the Mbed OS block device interface.
+ * @bug No known bugs.
+ */
+#ifndef STORAGE_SIM_BLOCK_DEVICE_H
+#define STORAGE_SIM_BLOCK_DEVICE_H
+
+#include <stdint.h>
+
+namespace mbed {
+
+typedef uint64_t bd_addr_t;
+typedef uint64_t bd_size_t;
+
+#define BD_ERROR_OK 0
+#define BD_ERROR_DEVICE_ERROR -4001
+
+class BlockDevice {
+public:
+  virtual ~BlockDevice() {}
+
+  /**
+   * @brief Returns the block device the board provides, here a file-backed
+   * model of the QSPI flash.
+   *
+   * @return The default block device.
+   */
+  static BlockDevice *get_default_instance();
+
+  virtual int init() = 0;
+  virtual int deinit() = 0;
+  virtual int sync() { return 0; }
+  virtual int read(void *buffer, bd_addr_t addr, bd_size_t size) = 0;
+  virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size) = 0;
+  virtual int erase(bd_addr_t, bd_size_t) { return 0; }
+  virtual int trim(bd_addr_t, bd_size_t) { return 0; }
+  virtual bd_size_t get_read_size() const = 0;
+  virtual bd_size_t get_program_size() const = 0;
+  virtual bd_size_t get_erase_size() const { return get_program_size(); }
+  virtual bd_size_t get_erase_size(bd_addr_t) const {
+    return get_erase_size();
+  }
+  virtual int get_erase_value() const { return -1; }
+  virtual bd_size_t size() const = 0;
+  virtual const char *get_type() const = 0;
+};
+
+} // namespace mbed
+
+using mbed::bd_addr_t;
+using mbed::bd_size_t;
+using mbed::BlockDevice;
+
+#endif // STORAGE_SIM_BLOCK_DEVICE_H
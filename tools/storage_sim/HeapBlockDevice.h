@@ -0,0 +1,107 @@
+/**
+ * @file HeapBlockDevice.h
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host stand-in for the Mbed OS heap block device, and a block device
+ * that keeps its contents in a file between runs.
+ * @bug No known bugs.
+ */
+#ifndef STORAGE_SIM_HEAP_BLOCK_DEVICE_H
+#define STORAGE_SIM_HEAP_BLOCK_DEVICE_H
+
+#include "BlockDevice.h"
+#include <stdint.h>
+
+/**
+ * @brief A block device in RAM. Unlike the Mbed OS one, erasing sets bytes
+ * to 0xFF, as on the QSPI flash, so quick erases and blank checks behave as
+ * on the board.
+ */
+class HeapBlockDevice : public mbed::BlockDevice {
+public:
+  /**
+   * @brief Construct a new HeapBlockDevice object.
+   *
+   * @param size The size of the device in bytes.
+   * @param read The read size in bytes.
+   * @param program The program size in bytes.
+   * @param erase The erase size in bytes.
+   * @return Instance of HeapBlockDevice.
+   */
+  HeapBlockDevice(bd_size_t size, bd_size_t read, bd_size_t program,
+                  bd_size_t erase);
+
+  virtual ~HeapBlockDevice();
+
+  virtual int init();
+  virtual int deinit();
+  virtual int read(void *buffer, bd_addr_t addr, bd_size_t size);
+  virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size);
+  virtual int erase(bd_addr_t addr, bd_size_t size);
+  virtual bd_size_t get_read_size() const { return _read_size; }
+  virtual bd_size_t get_program_size() const { return _program_size; }
+  virtual bd_size_t get_erase_size() const { return _erase_size; }
+  virtual int get_erase_value() const { return 0xFF; }
+  virtual bd_size_t size() const { return _size; }
+  virtual const char *get_type() const { return "HEAP"; }
+
+protected:
+  uint8_t *_data;
+  bd_size_t _size;
+
+private:
+  bd_size_t _read_size;
+  bd_size_t _program_size;
+  bd_size_t _erase_size;
+  int _init_ref_count;
+
+  /**
+   * @brief Checks that an operation lies on the device and is aligned.
+   *
+   * @return True if the operation is valid.
+   */
+  bool _is_valid(bd_addr_t addr, bd_size_t size, bd_size_t unit) const;
+};
+
+/**
+ * @brief A block device in RAM that is loaded from a file on init and saved
+ * back to it on deinit, so the file system outlives the process. Syncs stay
+ * in RAM, which keeps log appends from rewriting the whole file.
+ */
+class FileBlockDevice : public HeapBlockDevice {
+public:
+  /**
+   * @brief Construct a new FileBlockDevice object.
+   *
+   * @param path The file holding the device contents, created when missing.
+   * @param size The size of the device in bytes.
+   * @param read The read size in bytes.
+   * @param program The program size in bytes.
+   * @param erase The erase size in bytes.
+   * @return Instance of FileBlockDevice.
+   */
+  FileBlockDevice(const char *path, bd_size_t size, bd_size_t read,
+                  bd_size_t program, bd_size_t erase);
+
+  virtual int init();
+  virtual int deinit();
+  virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size);
+  virtual int erase(bd_addr_t addr, bd_size_t size);
+  virtual const char *get_type() const { return "FILE"; }
+
+  /**
+   * @brief Sets the file used by the next init.
+   *
+   * @param path The file holding the device contents.
+   * @return Void.
+   */
+  void set_path(const char *path) { _path = path; }
+
+private:
+  const char *_path;
+  bool _dirty; // Changed since the file was last saved
+};
+
+#endif // STORAGE_SIM_HEAP_BLOCK_DEVICE_H
@@ -0,0 +1,104 @@
+/**
+ * @file LittleFileSystem.h
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host stand-in for the Mbed OS LittleFS v1 file system. Files under
+ * its mount point are opened, renamed and removed through the C library, as
+ * the Mbed OS retargeting does on the board.
+ * @bug No known bugs.
+ */
+#ifndef STORAGE_SIM_LITTLE_FILE_SYSTEM_H
+#define STORAGE_SIM_LITTLE_FILE_SYSTEM_H
+
+#include "BlockDevice.h"
+#include <stdio.h>
+
+extern "C" {
+#include "lfs.h"
+}
+
+class LittleFileSystem {
+public:
+  /**
+   * @brief Construct a new LittleFileSystem object mounted on /name.
+   *
+   * @param name The mount point, without slashes.
+   * @param bd Must be NULL, the device is given to mount().
+   * @param read_size The minimum read size in bytes.
+   * @param prog_size The minimum program size in bytes.
+   * @param block_size The minimum block size in bytes.
+   * @param lookahead The lookahead in blocks.
+   * @return Instance of LittleFileSystem.
+   */
+  LittleFileSystem(const char *name, mbed::BlockDevice *bd,
+                   lfs_size_t read_size, lfs_size_t prog_size,
+                   lfs_size_t block_size, lfs_size_t lookahead);
+
+  ~LittleFileSystem();
+
+  /**
+   * @brief Mounts the file system on a block device.
+   *
+   * @param bd The block device.
+   * @return 0 upon success, negative error code on failure.
+   */
+  int mount(mbed::BlockDevice *bd);
+
+  /**
+   * @brief Unmounts the file system, if it is mounted.
+   *
+   * @return 0 upon success, negative error code on failure.
+   */
+  int unmount();
+
+  /**
+   * @brief Formats a block device and mounts it.
+   *
+   * @param bd The block device, NULL for the mounted one.
+   * @return 0 upon success, negative error code on failure.
+   */
+  int reformat(mbed::BlockDevice *bd);
+
+  /**
+   * @brief Opens a file below the mount point as a C stream.
+   *
+   * @param path The path of the file within the file system.
+   * @param mode The fopen() mode.
+   * @return The open stream, NULL with errno set on failure.
+   */
+  FILE *open(const char *path, const char *mode);
+
+  int remove(const char *path);
+  int rename(const char *path, const char *new_path);
+
+  /**
+   * @brief Finds the mounted file system a path belongs to.
+   *
+   * @param path An absolute path.
+   * @param rest Set to the path within the file system.
+   * @return The file system, NULL if the path is on the host.
+   */
+  static LittleFileSystem *lookup(const char *path, const char **rest);
+
+private:
+  const char *_name;
+  lfs_t _lfs;
+  struct lfs_config _config;
+  mbed::BlockDevice *_bd;
+  lfs_size_t _read_size;
+  lfs_size_t _prog_size;
+  lfs_size_t _block_size;
+  lfs_size_t _lookahead;
+  LittleFileSystem *_next;
+
+  /**
+   * @brief Fills in the LittleFS configuration for a block device.
+   *
+   * @return Void.
+   */
+  void _configure(mbed::BlockDevice *bd);
+};
+
+#endif // STORAGE_SIM_LITTLE_FILE_SYSTEM_H
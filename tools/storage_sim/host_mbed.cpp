@@ -0,0 +1,461 @@
+/**
+ * @file host_mbed.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host stand-in for the Mbed OS block devices, LittleFS v1 file system
+ * and file retargeting used by the datastore.
+ *
+ * Streams under a mount point are routed to LittleFS by linking with
+ * -Wl,--wrap=fopen,--wrap=remove,--wrap=rename, so that datastore.cpp keeps
+ * calling the C library as it does on the board.
+ * @bug No known bugs.
+ */
+#include "HeapBlockDevice.h"
+#include "LittleFileSystem.h"
+#include "mbed.h"
+#include <errno.h>
+
+extern "C" {
+FILE *__real_fopen(const char *path, const char *mode);
+int __real_remove(const char *path);
+int __real_rename(const char *path, const char *new_path);
+}
+
+// Geometry of the MX25R6435F QSPI flash as QSPIFBlockDevice reports it
+#define QSPIF_SIZE (8 * 1024 * 1024)
+#define QSPIF_READ_SIZE 1
+#define QSPIF_PROGRAM_SIZE 1
+#define QSPIF_ERASE_SIZE 4096
+
+void mbed::error(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  exit(1);
+}
+
+mbed::BlockDevice *mbed::BlockDevice::get_default_instance() {
+  static FileBlockDevice qspif("storage.bin", QSPIF_SIZE, QSPIF_READ_SIZE,
+                               QSPIF_PROGRAM_SIZE, QSPIF_ERASE_SIZE);
+  return &qspif;
+}
+
+HeapBlockDevice::HeapBlockDevice(bd_size_t size, bd_size_t read,
+                                 bd_size_t program, bd_size_t erase)
+    : _data(NULL), _size(size), _read_size(read), _program_size(program),
+      _erase_size(erase), _init_ref_count(0) {}
+
+HeapBlockDevice::~HeapBlockDevice() { free(_data); }
+
+int HeapBlockDevice::init() {
+  if (_init_ref_count++ > 0) {
+    return 0;
+  }
+  if (!_data) {
+    _data = (uint8_t *)malloc(_size);
+    if (!_data) {
+      _init_ref_count = 0;
+      return BD_ERROR_DEVICE_ERROR;
+    }
+    memset(_data, 0xFF, _size);
+  }
+  return 0;
+}
+
+int HeapBlockDevice::deinit() {
+  if (_init_ref_count > 0) {
+    _init_ref_count--;
+  }
+  return 0;
+}
+
+bool HeapBlockDevice::_is_valid(bd_addr_t addr, bd_size_t size,
+                                bd_size_t unit) const {
+  return _data && addr % unit == 0 && size % unit == 0 && addr <= _size &&
+         size <= _size - addr;
+}
+
+int HeapBlockDevice::read(void *buffer, bd_addr_t addr, bd_size_t size) {
+  if (!_is_valid(addr, size, _read_size)) {
+    return BD_ERROR_DEVICE_ERROR;
+  }
+  memcpy(buffer, _data + addr, size);
+  return 0;
+}
+
+int HeapBlockDevice::program(const void *buffer, bd_addr_t addr,
+                             bd_size_t size) {
+  if (!_is_valid(addr, size, _program_size)) {
+    return BD_ERROR_DEVICE_ERROR;
+  }
+  // Programming only clears bits, as on NOR flash
+  const uint8_t *bytes = (const uint8_t *)buffer;
+  for (bd_size_t i = 0; i < size; i++) {
+    _data[addr + i] &= bytes[i];
+  }
+  return 0;
+}
+
+int HeapBlockDevice::erase(bd_addr_t addr, bd_size_t size) {
+  if (!_is_valid(addr, size, _erase_size)) {
+    return BD_ERROR_DEVICE_ERROR;
+  }
+  memset(_data + addr, 0xFF, size);
+  return 0;
+}
+
+FileBlockDevice::FileBlockDevice(const char *path, bd_size_t size,
+                                 bd_size_t read, bd_size_t program,
+                                 bd_size_t erase)
+    : HeapBlockDevice(size, read, program, erase), _path(path),
+      _dirty(false) {}
+
+int FileBlockDevice::init() {
+  bool loaded = _data != NULL;
+  int err = HeapBlockDevice::init();
+  if (err || loaded) {
+    return err;
+  }
+  // A missing or short file reads as erased flash
+  FILE *f = __real_fopen(_path, "rb");
+  if (f) {
+    fread(_data, 1, _size, f);
+    fclose(f);
+  }
+  return 0;
+}
+
+int FileBlockDevice::deinit() {
+  HeapBlockDevice::deinit();
+  if (!_data || !_dirty) {
+    return 0;
+  }
+  FILE *f = __real_fopen(_path, "wb");
+  if (!f) {
+    return BD_ERROR_DEVICE_ERROR;
+  }
+  size_t written = fwrite(_data, 1, _size, f);
+  if (fclose(f) != 0 || written != _size) {
+    return BD_ERROR_DEVICE_ERROR;
+  }
+  _dirty = false;
+  return 0;
+}
+
+int FileBlockDevice::program(const void *buffer, bd_addr_t addr,
+                             bd_size_t size) {
+  _dirty = true;
+  return HeapBlockDevice::program(buffer, addr, size);
+}
+
+int FileBlockDevice::erase(bd_addr_t addr, bd_size_t size) {
+  _dirty = true;
+  return HeapBlockDevice::erase(addr, size);
+}
+
+/**
+ * @brief Mounted file systems, searched by path.
+ */
+static LittleFileSystem *file_systems = NULL;
+
+/**
+ * @brief Converts a LittleFS error into an errno value, as Mbed OS does.
+ *
+ * @return The errno value.
+ */
+static int lfs_to_errno(int err) {
+  switch (err) {
+  case LFS_ERR_NOENT:
+    return ENOENT;
+  case LFS_ERR_EXIST:
+    return EEXIST;
+  case LFS_ERR_NOTDIR:
+    return ENOTDIR;
+  case LFS_ERR_ISDIR:
+    return EISDIR;
+  case LFS_ERR_INVAL:
+    return EINVAL;
+  case LFS_ERR_NOSPC:
+    return ENOSPC;
+  case LFS_ERR_NOMEM:
+    return ENOMEM;
+  default:
+    return EIO;
+  }
+}
+
+static int lfs_bd_read(const struct lfs_config *c, lfs_block_t block,
+                       lfs_off_t off, void *buffer, lfs_size_t size) {
+  mbed::BlockDevice *bd = (mbed::BlockDevice *)c->context;
+  return bd->read(buffer, (bd_addr_t)block * c->block_size + off, size);
+}
+
+static int lfs_bd_prog(const struct lfs_config *c, lfs_block_t block,
+                       lfs_off_t off, const void *buffer, lfs_size_t size) {
+  mbed::BlockDevice *bd = (mbed::BlockDevice *)c->context;
+  return bd->program(buffer, (bd_addr_t)block * c->block_size + off, size);
+}
+
+static int lfs_bd_erase(const struct lfs_config *c, lfs_block_t block) {
+  mbed::BlockDevice *bd = (mbed::BlockDevice *)c->context;
+  return bd->erase((bd_addr_t)block * c->block_size, c->block_size);
+}
+
+static int lfs_bd_sync(const struct lfs_config *c) {
+  mbed::BlockDevice *bd = (mbed::BlockDevice *)c->context;
+  return bd->sync();
+}
+
+LittleFileSystem::LittleFileSystem(const char *name, mbed::BlockDevice *bd,
+                                   lfs_size_t read_size, lfs_size_t prog_size,
+                                   lfs_size_t block_size, lfs_size_t lookahead)
+    : _name(name), _bd(NULL), _read_size(read_size), _prog_size(prog_size),
+      _block_size(block_size), _lookahead(lookahead), _next(file_systems) {
+  file_systems = this;
+  if (bd) {
+    mount(bd);
+  }
+}
+
+LittleFileSystem::~LittleFileSystem() {
+  unmount();
+  for (LittleFileSystem **fs = &file_systems; *fs; fs = &(*fs)->_next) {
+    if (*fs == this) {
+      *fs = _next;
+      break;
+    }
+  }
+}
+
+void LittleFileSystem::_configure(mbed::BlockDevice *bd) {
+  // The sizes are raised to what the block device needs, like Mbed OS does
+  memset(&_config, 0, sizeof(_config));
+  _config.context = bd;
+  _config.read = lfs_bd_read;
+  _config.prog = lfs_bd_prog;
+  _config.erase = lfs_bd_erase;
+  _config.sync = lfs_bd_sync;
+  _config.read_size = bd->get_read_size();
+  if (_config.read_size < _read_size) {
+    _config.read_size = _read_size;
+  }
+  _config.prog_size = bd->get_program_size();
+  if (_config.prog_size < _prog_size) {
+    _config.prog_size = _prog_size;
+  }
+  _config.block_size = bd->get_erase_size();
+  if (_config.block_size < _block_size) {
+    _config.block_size = _block_size;
+  }
+  _config.block_count = bd->size() / _config.block_size;
+  _config.lookahead = 32 * ((_config.block_count + 31) / 32);
+  if (_config.lookahead > _lookahead) {
+    _config.lookahead = _lookahead;
+  }
+}
+
+int LittleFileSystem::mount(mbed::BlockDevice *bd) {
+  int err = bd->init();
+  if (err) {
+    return err;
+  }
+  _configure(bd);
+  err = lfs_mount(&_lfs, &_config);
+  if (err) {
+    bd->deinit();
+    return -lfs_to_errno(err);
+  }
+  _bd = bd;
+  return 0;
+}
+
+int LittleFileSystem::unmount() {
+  if (!_bd) {
+    return 0;
+  }
+  int err = lfs_unmount(&_lfs);
+  int bd_err = _bd->deinit();
+  _bd = NULL;
+  return err ? -lfs_to_errno(err) : bd_err;
+}
+
+int LittleFileSystem::reformat(mbed::BlockDevice *bd) {
+  if (_bd) {
+    if (!bd) {
+      bd = _bd;
+    }
+    unmount();
+  }
+  if (!bd) {
+    return -ENODEV;
+  }
+  int err = bd->init();
+  if (err) {
+    return err;
+  }
+  _configure(bd);
+  err = lfs_format(&_lfs, &_config);
+  bd->deinit();
+  if (err) {
+    return -lfs_to_errno(err);
+  }
+  return mount(bd);
+}
+
+/**
+ * @brief An open LittleFS file behind a C stream.
+ */
+typedef struct {
+  lfs_t *lfs;
+  lfs_file_t file;
+} lfs_stream_t;
+
+static ssize_t stream_read(void *cookie, char *buf, size_t size) {
+  lfs_stream_t *stream = (lfs_stream_t *)cookie;
+  lfs_ssize_t res = lfs_file_read(stream->lfs, &stream->file, buf, size);
+  if (res < 0) {
+    errno = lfs_to_errno(res);
+    return -1;
+  }
+  return res;
+}
+
+static ssize_t stream_write(void *cookie, const char *buf, size_t size) {
+  lfs_stream_t *stream = (lfs_stream_t *)cookie;
+  lfs_ssize_t res = lfs_file_write(stream->lfs, &stream->file, buf, size);
+  if (res < 0) {
+    errno = lfs_to_errno(res);
+    return 0;
+  }
+  return res;
+}
+
+static int stream_seek(void *cookie, off64_t *offset, int whence) {
+  lfs_stream_t *stream = (lfs_stream_t *)cookie;
+  int lfs_whence = whence == SEEK_CUR   ? LFS_SEEK_CUR
+                   : whence == SEEK_END ? LFS_SEEK_END
+                                        : LFS_SEEK_SET;
+  lfs_soff_t res =
+      lfs_file_seek(stream->lfs, &stream->file, *offset, lfs_whence);
+  if (res < 0) {
+    errno = lfs_to_errno(res);
+    return -1;
+  }
+  *offset = res;
+  return 0;
+}
+
+static int stream_close(void *cookie) {
+  lfs_stream_t *stream = (lfs_stream_t *)cookie;
+  int err = lfs_file_close(stream->lfs, &stream->file);
+  delete stream;
+  if (err) {
+    errno = lfs_to_errno(err);
+    return -1;
+  }
+  return 0;
+}
+
+FILE *LittleFileSystem::open(const char *path, const char *mode) {
+  if (!_bd) {
+    errno = ENODEV;
+    return NULL;
+  }
+  // Mapped the way the Mbed OS retargeting maps fopen() modes
+  bool update = strchr(mode, '+') != NULL;
+  int flags;
+  const char *stream_mode;
+  if (mode[0] == 'r') {
+    flags = update ? LFS_O_RDWR : LFS_O_RDONLY;
+    stream_mode = update ? "r+" : "r";
+  } else if (mode[0] == 'w') {
+    flags = (update ? LFS_O_RDWR : LFS_O_WRONLY) | LFS_O_CREAT | LFS_O_TRUNC;
+    stream_mode = update ? "r+" : "w";
+  } else if (mode[0] == 'a') {
+    flags = (update ? LFS_O_RDWR : LFS_O_WRONLY) | LFS_O_CREAT | LFS_O_APPEND;
+    stream_mode = update ? "r+" : "w";
+  } else {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  lfs_stream_t *stream = new lfs_stream_t;
+  stream->lfs = &_lfs;
+  int err = lfs_file_open(&_lfs, &stream->file, path, flags);
+  if (err) {
+    delete stream;
+    errno = lfs_to_errno(err);
+    return NULL;
+  }
+  cookie_io_functions_t io = {stream_read, stream_write, stream_seek,
+                              stream_close};
+  FILE *f = fopencookie(stream, stream_mode, io);
+  if (!f) {
+    lfs_file_close(&_lfs, &stream->file);
+    delete stream;
+  }
+  return f;
+}
+
+int LittleFileSystem::remove(const char *path) {
+  int err = _bd ? lfs_remove(&_lfs, path) : LFS_ERR_NOENT;
+  if (err) {
+    errno = lfs_to_errno(err);
+    return -1;
+  }
+  return 0;
+}
+
+int LittleFileSystem::rename(const char *path, const char *new_path) {
+  int err = _bd ? lfs_rename(&_lfs, path, new_path) : LFS_ERR_NOENT;
+  if (err) {
+    errno = lfs_to_errno(err);
+    return -1;
+  }
+  return 0;
+}
+
+LittleFileSystem *LittleFileSystem::lookup(const char *path,
+                                           const char **rest) {
+  if (path[0] != '/') {
+    return NULL;
+  }
+  for (LittleFileSystem *fs = file_systems; fs; fs = fs->_next) {
+    size_t length = strlen(fs->_name);
+    if (strncmp(path + 1, fs->_name, length) == 0 &&
+        path[1 + length] == '/') {
+      *rest = path + 2 + length;
+      return fs;
+    }
+  }
+  return NULL;
+}
+
+extern "C" FILE *__wrap_fopen(const char *path, const char *mode) {
+  const char *rest;
+  LittleFileSystem *fs = LittleFileSystem::lookup(path, &rest);
+  return fs ? fs->open(rest, mode) : __real_fopen(path, mode);
+}
+
+extern "C" int __wrap_remove(const char *path) {
+  const char *rest;
+  LittleFileSystem *fs = LittleFileSystem::lookup(path, &rest);
+  return fs ? fs->remove(rest) : __real_remove(path);
+}
+
+extern "C" int __wrap_rename(const char *path, const char *new_path) {
+  const char *rest;
+  const char *new_rest;
+  LittleFileSystem *fs = LittleFileSystem::lookup(path, &rest);
+  if (!fs) {
+    return __real_rename(path, new_path);
+  }
+  if (LittleFileSystem::lookup(new_path, &new_rest) != fs) {
+    errno = EXDEV;
+    return -1;
+  }
+  return fs->rename(rest, new_rest);
+}
@@ -0,0 +1,95 @@
+/**
+ * @file mbed.h
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host stand-in for the parts of Mbed OS the datastore uses, so
+ * datastore.cpp builds unchanged on Linux.
+ * @bug No known bugs.
+ */
+#ifndef STORAGE_SIM_MBED_H
+#define STORAGE_SIM_MBED_H
+
+#include "mbed_config.h"
+#include <chrono>
+#include <functional>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+namespace mbed {
+
+/**
+ * @brief Prints a fatal error and stops, as Mbed OS halts the board.
+ *
+ * @return Does not return.
+ */
+[[noreturn]] void error(const char *format, ...);
+
+/**
+ * @brief A stopwatch on the host's monotonic clock.
+ */
+class Timer {
+public:
+  Timer() : _running(false), _elapsed(0) {}
+
+  void start() {
+    if (!_running) {
+      _started = std::chrono::steady_clock::now();
+      _running = true;
+    }
+  }
+
+  void stop() {
+    _elapsed = elapsed_time();
+    _running = false;
+  }
+
+  void reset() {
+    _elapsed = std::chrono::microseconds(0);
+    _started = std::chrono::steady_clock::now();
+  }
+
+  std::chrono::microseconds elapsed_time() const {
+    if (!_running) {
+      return _elapsed;
+    }
+    return _elapsed + std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - _started);
+  }
+
+private:
+  bool _running;
+  std::chrono::microseconds _elapsed;
+  std::chrono::steady_clock::time_point _started;
+};
+
+} // namespace mbed
+
+namespace events {
+
+/**
+ * @brief An event queue without a dispatch thread. Calls run at once, as if
+ * the queue were dispatched right after they were posted.
+ */
+class EventQueue {
+public:
+  template <typename F, typename... Args> int call(F f, Args... args) {
+    f(args...);
+    return ++_id;
+  }
+
+private:
+  int _id = 0;
+};
+
+} // namespace events
+
+using namespace mbed;
+using namespace events;
+
+#endif // STORAGE_SIM_MBED_H
@@ -0,0 +1,43 @@
+/**
+ * @file mbed_config.h
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host stand-in for the configuration Mbed OS generates from
+ * mbed_app.json. The defaults follow mbed_app.json, except that profiling is
+ * always on, and each can be overridden with -D.
+ * @bug No known bugs.
+ */
+#ifndef STORAGE_SIM_MBED_CONFIG_H
+#define STORAGE_SIM_MBED_CONFIG_H
+
+// BlockDevice::get_default_instance() models the QSPI flash
+#define COMPONENT_QSPIF 1
+
+#ifndef MBED_CONF_APP_STORAGE_SIM
+#define MBED_CONF_APP_STORAGE_SIM 0
+#endif
+#ifndef MBED_CONF_APP_STORAGE_SIM_SIZE
+#define MBED_CONF_APP_STORAGE_SIM_SIZE 262144
+#endif
+#ifndef MBED_CONF_APP_STORAGE_PROFILE
+#define MBED_CONF_APP_STORAGE_PROFILE 1
+#endif
+#ifndef MBED_CONF_APP_STORAGE_BENCHMARK_APPENDS
+#define MBED_CONF_APP_STORAGE_BENCHMARK_APPENDS 10000
+#endif
+#ifndef MBED_CONF_APP_LFS_READ_SIZE
+#define MBED_CONF_APP_LFS_READ_SIZE 64
+#endif
+#ifndef MBED_CONF_APP_LFS_PROG_SIZE
+#define MBED_CONF_APP_LFS_PROG_SIZE 64
+#endif
+#ifndef MBED_CONF_APP_LFS_BLOCK_SIZE
+#define MBED_CONF_APP_LFS_BLOCK_SIZE 4096
+#endif
+#ifndef MBED_CONF_APP_LFS_LOOKAHEAD
+#define MBED_CONF_APP_LFS_LOOKAHEAD 2048
+#endif
+
+#endif // STORAGE_SIM_MBED_CONFIG_H
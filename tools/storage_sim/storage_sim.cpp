@@ -0,0 +1,124 @@
+/**
+ * @file storage_sim.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief Host build of the datastore on a file-backed model of the QSPI
+ * flash. It times mount_fs(), write_log() and key reads, counts the block
+ * device operations behind each and prints their modeled flash time and the
+ * erase counts per block.
+ * @bug No known bugs.
+ */
+#include "HeapBlockDevice.h"
+#include "datastore.hpp"
+
+// Defined by datastore.cpp
+extern LittleFileSystem fs;
+extern InstrumentedBlockDevice profiled_bd;
+
+#define KEY_READS 1000
+
+using namespace std::chrono;
+
+static const char *image_path = "storage.bin";
+static int log_writes = 1000;
+static bool fresh = false;
+
+/**
+ * @brief Prints what a step cost, then clears the counters for the next one.
+ *
+ * @return Void.
+ */
+static void report(const char *step, int count, const Timer &timer) {
+  long long elapsed = duration_cast<microseconds>(timer.elapsed_time()).count();
+  uint64_t modeled = profiled_bd.get_modeled_us();
+  printf("> %s x%d: %lld us host, %" PRIu64 " us modeled flash (%" PRIu64
+         " us each)\n",
+         step, count, elapsed, modeled, modeled / count);
+  profiled_bd.print_stats();
+  profiled_bd.reset_stats();
+}
+
+/**
+ * @brief Parses the command line.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int parse_options(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--fresh") == 0) {
+      fresh = true;
+    } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      image_path = argv[++i];
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      log_writes = atoi(argv[++i]);
+    } else {
+      return -1;
+    }
+  }
+  return log_writes > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+  if (parse_options(argc, argv) < 0) {
+    printf("Usage: %s [-f IMAGE] [-n LOG_WRITES] [--fresh]\n"
+           "  -f IMAGE   Flash image, kept between runs (default storage.bin)\n"
+           "  -n COUNT   Number of write_log() calls (default 1000)\n"
+           "  --fresh    Start from erased flash\n",
+           argv[0]);
+    return 1;
+  }
+#if !MBED_CONF_APP_STORAGE_SIM
+  FileBlockDevice *flash =
+      static_cast<FileBlockDevice *>(BlockDevice::get_default_instance());
+  flash->set_path(image_path);
+  if (fresh) {
+    remove(image_path);
+  }
+#endif
+
+  Timer timer;
+  timer.start();
+  printf("Mounting the file system... ");
+  mount_fs();
+  report("mount_fs", 1, timer);
+
+  if (load_keystore() < 0) {
+    uint8_t key[PRIVATE_KEY_SIZE] = {0};
+    set_private_key(key);
+    set_recovery_keys("123456234567345678456789567890678901");
+    profiled_bd.reset_stats();
+  }
+
+  int status = 0;
+  timer.reset();
+  for (int i = 0; i < log_writes; i++) {
+    if (write_log(BENCHMARK_LOG_MESSAGE) < 0) {
+      printf("> write_log failed after %d writes\n", i);
+      log_writes = i ? i : 1;
+      status = 1;
+      break;
+    }
+  }
+  report("write_log", log_writes, timer);
+
+  uint8_t key[PRIVATE_KEY_SIZE];
+  timer.reset();
+  for (int i = 0; i < KEY_READS; i++) {
+    if (load_keystore() < 0 || get_private_key(key) < 0) {
+      printf("> Keystore read failed\n");
+      return 1;
+    }
+  }
+  report("load_keystore", KEY_READS, timer);
+
+  timer.reset();
+  fs.unmount();
+  printf("Remounting the file system... ");
+  mount_fs();
+  report("mount_fs", 1, timer);
+
+  run_storage_benchmark();
+  return fs.unmount() == 0 ? status : 1;
+}
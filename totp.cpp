@@ -12,41 +12,42 @@
 /**
  * @brief does the hmac calculation
  */
-int manual_HMAC(uint8_t *secret, uint8_t *counter, uint8_t *digest) {
+int manual_HMAC(const uint8_t *secret, uint8_t *counter, uint8_t *digest) {
   // H((secret xor ipad) + counter)
   uint8_t i_key[PSA_HASH_MAX_SIZE] = {0};
-  for (int i = 0; i < 10; i++) {
+  for (int i = 0; i < PRIVATE_KEY_SIZE; i++) {
     i_key[i] = secret[i] ^ 0x36;
   }
-  for (int i = 10; i < PSA_HASH_MAX_SIZE; i++) {
+  for (int i = PRIVATE_KEY_SIZE; i < PSA_HASH_MAX_SIZE; i++) {
     i_key[i] = 0x36;
   }
 
   uint8_t i_sha[SHA1_DIGEST_LENGTH];
 
   /* Compute hash of inner message  */
-  mbedtls_sha1_context *ctx =
-      (mbedtls_sha1_context *)malloc(sizeof(mbedtls_sha1_context));
+  mbedtls_sha1_context ctx;
+  mbedtls_sha1_init(&ctx);
 
-  mbedtls_sha1_starts_ret(ctx);
-  mbedtls_sha1_update_ret(ctx, i_key, SHA1_BLOCKSIZE);
-  mbedtls_sha1_update_ret(ctx, counter, 8);
-  mbedtls_sha1_finish_ret(ctx, i_sha);
+  mbedtls_sha1_starts_ret(&ctx);
+  mbedtls_sha1_update_ret(&ctx, i_key, SHA1_BLOCKSIZE);
+  mbedtls_sha1_update_ret(&ctx, counter, 8);
+  mbedtls_sha1_finish_ret(&ctx, i_sha);
 
   // HMAC = H[(secret xor opad) + H((secret xor ipad) + counter)];
   uint8_t o_key[PSA_HASH_MAX_SIZE] = {0};
-  for (int i = 0; i < 10; i++) {
+  for (int i = 0; i < PRIVATE_KEY_SIZE; i++) {
     o_key[i] = secret[i] ^ 0x5c;
   }
-  for (int i = 10; i < PSA_HASH_MAX_SIZE; i++) {
+  for (int i = PRIVATE_KEY_SIZE; i < PSA_HASH_MAX_SIZE; i++) {
     o_key[i] = 0x5c;
   }
 
   /* Compute hash of outer message  */
-  mbedtls_sha1_starts_ret(ctx);
-  mbedtls_sha1_update_ret(ctx, o_key, SHA1_BLOCKSIZE);
-  mbedtls_sha1_update_ret(ctx, i_sha, SHA1_DIGEST_LENGTH);
-  mbedtls_sha1_finish_ret(ctx, digest);
+  mbedtls_sha1_starts_ret(&ctx);
+  mbedtls_sha1_update_ret(&ctx, o_key, SHA1_BLOCKSIZE);
+  mbedtls_sha1_update_ret(&ctx, i_sha, SHA1_DIGEST_LENGTH);
+  mbedtls_sha1_finish_ret(&ctx, digest);
+  mbedtls_sha1_free(&ctx);
 
   return 0;
 }
@@ -66,36 +67,64 @@ int DT(uint8_t *hmac_result) {
   return p;
 }
 
-int validate_for_time(const char *secret_hex, const char *TOTP_string,
+int validate_for_time(const uint8_t *secret, const char *TOTP_string,
                       time_t unix_time) {
   // t0 = 0, timestep = 30
   unsigned long counter = unix_time / 30;
-  uint8_t *counter_bytes = (uint8_t *)malloc(8);
+  uint8_t counter_bytes[8];
   for (int i = 7; i >= 0; i--) {
     counter_bytes[i] = counter;
     counter >>= 8;
   }
 
-  // convert to binary (byte array)
-  uint8_t *secret_bytes = (uint8_t *)malloc(10);
-  int pos = 0;
-  for (int i = 0; i < 10; i++) {
-    sscanf(secret_hex + pos, "%02hhx", &secret_bytes[i]);
-    pos += 2;
-  }
-
-  uint8_t *hmac_out = (uint8_t *)malloc(SHA1_DIGEST_LENGTH);
+  uint8_t hmac_out[SHA1_DIGEST_LENGTH];
 
-  manual_HMAC(secret_bytes, counter_bytes, hmac_out);
+  manual_HMAC(secret, counter_bytes, hmac_out);
   int TOTP = DT(hmac_out) % 1000000;
   int TOTP_input = atoi(TOTP_string);
 
   return TOTP == TOTP_input;
 }
 
-int validate(const char *secret_hex, const char *TOTP_string) {
+void derive_lock_secret(const uint8_t *master, int lock, uint8_t *secret) {
+  if (lock == 0) {
+    memcpy(secret, master, PRIVATE_KEY_SIZE);
+    return;
+  }
+  // HMAC(private key, "LOCK" + index); the prefix keeps the message far from
+  // any TOTP counter computed with the same key
+  uint8_t message[8] = {'L',
+                        'O',
+                        'C',
+                        'K',
+                        (uint8_t)(lock >> 24),
+                        (uint8_t)(lock >> 16),
+                        (uint8_t)(lock >> 8),
+                        (uint8_t)lock};
+  uint8_t digest[SHA1_DIGEST_LENGTH];
+  manual_HMAC(master, message, digest);
+  memcpy(secret, digest, PRIVATE_KEY_SIZE);
+}
+
+/**
+ * @brief The number of 30 second steps accepted either side of the RTC time.
+ */
+static volatile int validation_window = 1;
+
+void set_validation_window(int steps) { validation_window = steps; }
+
+int validate(const uint8_t *secret, const char *TOTP_string) {
+  TRACE_SCOPE(TRACE_VALIDATE, 0);
   time_t current_time = time(NULL);
-  return validate_for_time(secret_hex, TOTP_string, current_time) ||
-         validate_for_time(secret_hex, TOTP_string, current_time + 30) ||
-         validate_for_time(secret_hex, TOTP_string, current_time - 30);
+  if (validate_for_time(secret, TOTP_string, current_time)) {
+    return 1;
+  }
+  int steps = validation_window;
+  for (int i = 1; i <= steps; i++) {
+    if (validate_for_time(secret, TOTP_string, current_time + 30 * i) ||
+        validate_for_time(secret, TOTP_string, current_time - 30 * i)) {
+      return 1;
+    }
+  }
+  return 0;
 }
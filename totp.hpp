@@ -10,6 +10,8 @@
 #ifndef TOTP_H
 #define TOTP_H
 
+#include "keys.hpp"
+#include "trace.hpp"
 #include <assert.h>
 #include <cstdint>
 #include <mbed.h>
@@ -22,14 +24,36 @@
 #define SHA1_DIGEST_LENGTH 20
 #define SHA1_BLOCKSIZE 64
 
+/**
+ * @brief Sets how far the RTC may be from the client's clock. Widen it while
+ * the RTC has not been synchronized.
+ *
+ * @param steps The number of 30 second steps accepted either side of the RTC
+ * time.
+ * @return Void.
+ */
+void set_validation_window(int steps);
+
+/**
+ * @brief Derives the TOTP secret of a lock from the stored private key, so a
+ * code for one lock does not open the others. Lock 0 uses the private key
+ * itself, which keeps authenticator apps enrolled before this working.
+ *
+ * @param master The PRIVATE_KEY_SIZE byte private key.
+ * @param lock The index of the lock.
+ * @param secret Buffer for the PRIVATE_KEY_SIZE byte secret of the lock.
+ * @return Void.
+ */
+void derive_lock_secret(const uint8_t *master, int lock, uint8_t *secret);
+
 /**
  * @brief Validates a single TOTP value for a given secret at the device's
- * current RTC time +-30.
+ * current RTC time, +-30 seconds per step of the validation window.
  *
- * @param secret_hex The private secret as a hex string.
+ * @param secret The PRIVATE_KEY_SIZE byte private secret.
  * @param TOTP_string The input TOTP value as a string.
  * @return 1 if valid, 0 otherwise.
  */
-int validate(const char *secret_hex, const char *TOTP_string);
+int validate(const uint8_t *secret, const char *TOTP_string);
 
 #endif // TOTP_H
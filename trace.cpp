@@ -0,0 +1,156 @@
+/**
+ * @file trace.cpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This module contains trace points that time the unlock path into a
+ * RAM ring buffer, and a dump of the buffer as a Chrome trace.
+ * @bug No known bugs.
+ */
+#include "trace.hpp"
+#include <inttypes.h>
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#endif
+
+#if MBED_CONF_APP_TRACE_ENABLED
+
+#if MBED_CONF_APP_TRACE_BUFFER_SIZE & (MBED_CONF_APP_TRACE_BUFFER_SIZE - 1)
+#error "trace-buffer-size must be a power of two"
+#endif
+
+static const char *const TRACE_EVENT_NAMES[TRACE_EVENT_COUNT] = {
+    "data written", "key fetch", "validate", "unlock", "write log"};
+
+static trace_record_t trace_buffer[MBED_CONF_APP_TRACE_BUFFER_SIZE];
+
+#if defined(__MBED__)
+static volatile uint32_t trace_head = 0;
+
+/**
+ * @brief Claims the next slot of the ring buffer.
+ *
+ * @return The number of records written before this one.
+ */
+static uint32_t trace_claim() {
+  return core_util_atomic_incr_u32(&trace_head, 1) - 1;
+}
+
+static uint32_t trace_last_cycles = 0;
+static uint64_t trace_wrapped_cycles = 0;
+static Ticker trace_wrap_ticker;
+
+/**
+ * @brief Reads the cycle counter extended to 64 bits. The 32-bit counter
+ * wraps every 53 s at 80 MHz, so trace_wrap_ticker reads it more often than
+ * that to catch every wrap.
+ *
+ * @return The cycles since trace_init().
+ */
+static uint64_t trace_ticks() {
+  CriticalSectionLock lock;
+  uint32_t cycles = DWT->CYCCNT;
+  if (cycles < trace_last_cycles) {
+    trace_wrapped_cycles += (uint64_t)1 << 32;
+  }
+  trace_last_cycles = cycles;
+  return trace_wrapped_cycles | cycles;
+}
+
+static void trace_observe_ticks() { trace_ticks(); }
+
+static uint32_t trace_ticks_per_us() { return SystemCoreClock / 1000000; }
+
+static uint32_t trace_thread() {
+  if (core_util_is_isr_active()) {
+    return 0;
+  }
+  return (uint32_t)(uintptr_t)ThisThread::get_id();
+}
+#else
+static std::atomic<uint32_t> trace_head(0);
+
+static uint32_t trace_claim() { return trace_head.fetch_add(1); }
+
+static uint64_t trace_ticks() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static uint32_t trace_ticks_per_us() { return 1000; }
+
+static uint32_t trace_thread() {
+  // Never 0, which marks interrupts
+  return std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+}
+#endif
+
+void trace_init() {
+#if defined(__MBED__)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  // Twice per wrap of the counter
+  trace_wrap_ticker.attach(
+      trace_observe_ticks,
+      std::chrono::milliseconds(((uint64_t)1 << 31) / SystemCoreClock * 1000));
+#endif
+}
+
+void trace_record(trace_event_t event, trace_phase_t phase, uint16_t arg) {
+  trace_record_t &record =
+      trace_buffer[trace_claim() & (MBED_CONF_APP_TRACE_BUFFER_SIZE - 1)];
+  record.ticks = trace_ticks();
+  record.thread = trace_thread();
+  record.event = event;
+  record.phase = phase;
+  record.arg = arg;
+}
+
+void trace_dump(FILE *out) {
+  uint32_t head = trace_head;
+  uint32_t first = head > MBED_CONF_APP_TRACE_BUFFER_SIZE
+                       ? head - MBED_CONF_APP_TRACE_BUFFER_SIZE
+                       : 0;
+  uint32_t ticks_per_us = trace_ticks_per_us();
+
+  fprintf(out, "{\"traceEvents\":[\n");
+  uint64_t start = trace_buffer[first & (MBED_CONF_APP_TRACE_BUFFER_SIZE - 1)]
+                       .ticks;
+  for (uint32_t i = first; i < head; i++) {
+    const trace_record_t &record =
+        trace_buffer[i & (MBED_CONF_APP_TRACE_BUFFER_SIZE - 1)];
+    // The first slot may be overwritten while dumping
+    uint64_t elapsed = record.ticks > start ? record.ticks - start : 0;
+    uint64_t ns = elapsed * 1000 / ticks_per_us;
+    fprintf(out,
+            "%s{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%" PRIu64 ".%03" PRIu64
+            ",\"pid\":1,\"tid\":%" PRIu32 ",\"args\":{\"arg\":%u}}\n",
+            i == first ? "" : ",",
+            record.event < TRACE_EVENT_COUNT ? TRACE_EVENT_NAMES[record.event]
+                                             : "unknown",
+            record.phase == TRACE_BEGIN ? "B" : "E", ns / 1000, ns % 1000,
+            record.thread, record.arg);
+  }
+  fprintf(out, "]}\n");
+}
+
+#else
+
+void trace_init() {}
+
+void trace_record(trace_event_t, trace_phase_t, uint16_t) {}
+
+void trace_dump(FILE *out) {
+  fprintf(out, "> Tracing is disabled, set trace-enabled in mbed_app.json\n");
+}
+
+#endif
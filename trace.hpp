@@ -0,0 +1,108 @@
+/**
+ * @file trace.hpp
+ * @author Kirill Tregubov (KirillTregubov)
+ * @author Philip Cai (Gadnalf)
+ * @copyright Copyright (c) 2022 Kirill Tregubov & Philip Cai
+ *
+ * @brief This header defines trace points that time the unlock path into a
+ * RAM ring buffer, and a dump of the buffer as a Chrome trace.
+ * @bug No known bugs.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef MBED_CONF_APP_TRACE_ENABLED
+#define MBED_CONF_APP_TRACE_ENABLED 0
+#endif
+#ifndef MBED_CONF_APP_TRACE_BUFFER_SIZE
+#define MBED_CONF_APP_TRACE_BUFFER_SIZE 256
+#endif
+
+/**
+ * @brief The spans recorded by trace points.
+ */
+typedef enum {
+  TRACE_DATA_WRITTEN,
+  TRACE_KEY_FETCH,
+  TRACE_VALIDATE,
+  TRACE_UNLOCK,
+  TRACE_WRITE_LOG,
+  TRACE_EVENT_COUNT
+} trace_event_t;
+
+/**
+ * @brief Whether a trace record opens or closes its span.
+ */
+typedef enum { TRACE_BEGIN, TRACE_END } trace_phase_t;
+
+/**
+ * @brief One trace record as it is kept in the ring buffer.
+ */
+typedef struct {
+  uint64_t ticks;  // Cycle count on the device, nanoseconds on a host
+  uint32_t thread; // Thread that recorded it, 0 for interrupts
+  uint8_t event;
+  uint8_t phase;
+  uint16_t arg;
+} trace_record_t;
+
+/**
+ * @brief Starts the cycle counter used to timestamp records, and a ticker
+ * that keeps extending it to 64 bits.
+ *
+ * @return Void.
+ */
+void trace_init();
+
+/**
+ * @brief Adds a record to the ring buffer, overwriting the oldest record once
+ * it is full. Safe to call from any thread or interrupt.
+ *
+ * @param event The span the record belongs to.
+ * @param phase Whether the span opens or closes.
+ * @param arg A value shown with the span.
+ * @return Void.
+ */
+void trace_record(trace_event_t event, trace_phase_t phase, uint16_t arg);
+
+/**
+ * @brief Writes the ring buffer, oldest record first, as Chrome trace JSON.
+ * Load the output in chrome://tracing or Perfetto.
+ *
+ * @param out The stream to write to.
+ * @return Void.
+ */
+void trace_dump(FILE *out);
+
+/**
+ * @brief Records a span that closes when the enclosing scope exits.
+ */
+class TraceScope {
+public:
+  TraceScope(trace_event_t event, uint16_t arg) : _event(event), _arg(arg) {
+    trace_record(_event, TRACE_BEGIN, _arg);
+  }
+  ~TraceScope() { trace_record(_event, TRACE_END, _arg); }
+
+private:
+  trace_event_t _event;
+  uint16_t _arg;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#if MBED_CONF_APP_TRACE_ENABLED
+/**
+ * @brief Traces the rest of the enclosing scope as a span.
+ */
+#define TRACE_SCOPE(event, arg)                                                \
+  TraceScope TRACE_CONCAT(trace_scope_, __LINE__)((event), (arg))
+#else
+#define TRACE_SCOPE(event, arg) ((void)0)
+#endif
+
+#endif // TRACE_H
@@ -9,16 +9,165 @@
  */
 #include "wifi_service.hpp"
 
+using namespace std::chrono;
+
+/**
+ * @brief Loads the cached network if it matches the current credentials.
+ *
+ * @return 0 upon success, -1 if there is no usable cache.
+ */
+static int load_wifi_cache(wifi_cache_t *cache) {
+  FILE *f = fopen(WIFI_CACHE_PATH, "rb");
+  if (!f) {
+    return -1;
+  }
+  size_t read = fread(cache, sizeof(*cache), 1, f);
+  fclose(f);
+  if (read != 1 || cache->magic != WIFI_CACHE_MAGIC ||
+      cache->crc != crc32(cache, offsetof(wifi_cache_t, crc)) ||
+      strncmp(cache->ssid, WIFI_SSID, sizeof(cache->ssid)) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Caches the joined network and the address it leased.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int save_wifi_cache(WiFiInterface *wifi, const uint8_t *bssid,
+                           uint8_t channel, nsapi_security_t security) {
+  wifi_cache_t cache;
+  memset(&cache, 0, sizeof(cache));
+  cache.magic = WIFI_CACHE_MAGIC;
+  strncpy(cache.ssid, WIFI_SSID, sizeof(cache.ssid) - 1);
+  memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+  cache.channel = channel;
+  cache.security = security;
+
+  SocketAddress address;
+  if (wifi->get_ip_address(&address) == NSAPI_ERROR_OK) {
+    strncpy(cache.ip, address.get_ip_address(), NSAPI_IPv4_SIZE - 1);
+  }
+  if (wifi->get_netmask(&address) == NSAPI_ERROR_OK) {
+    strncpy(cache.netmask, address.get_ip_address(), NSAPI_IPv4_SIZE - 1);
+  }
+  if (wifi->get_gateway(&address) == NSAPI_ERROR_OK) {
+    strncpy(cache.gateway, address.get_ip_address(), NSAPI_IPv4_SIZE - 1);
+  }
+  cache.saved = time(NULL);
+  cache.crc = crc32(&cache, offsetof(wifi_cache_t, crc));
+
+  FILE *f = fopen(WIFI_CACHE_PATH, "wb");
+  if (!f) {
+    printf("Cannot open file for write %s: %s\n", WIFI_CACHE_PATH,
+           strerror(errno));
+    return -1;
+  }
+  size_t written = fwrite(&cache, sizeof(cache), 1, f);
+  fclose(f);
+  return written == 1 ? 0 : -1;
+}
+
+/**
+ * @brief Checks whether the cached address is likely still leased to us.
+ *
+ * @return True if the address can be reused without DHCP.
+ */
+static bool lease_valid(const wifi_cache_t *cache) {
+  time_t now = time(NULL);
+  return cache->ip[0] && now >= (time_t)cache->saved &&
+         now - (time_t)cache->saved < MBED_CONF_APP_WIFI_LEASE_S;
+}
+
+/**
+ * @brief Joins the cached network without scanning. Interfaces that cannot
+ * pin a channel or a static address ignore them.
+ *
+ * @return 0 upon success, -1 on error / failure.
+ */
+static int connect_cached(WiFiInterface *wifi, const wifi_cache_t *cache) {
+  bool static_ip = false;
+  if (lease_valid(cache)) {
+    SocketAddress ip(cache->ip), netmask(cache->netmask),
+        gateway(cache->gateway);
+    static_ip = wifi->set_network(ip, netmask, gateway) == NSAPI_ERROR_OK &&
+                wifi->set_dhcp(false) == NSAPI_ERROR_OK;
+  }
+  if (!static_ip) {
+    // An expired lease must be renewed by DHCP, not saved again
+    wifi->set_dhcp(true);
+  }
+
+  int status = wifi->connect(WIFI_SSID, WIFI_PASSWORD,
+                             (nsapi_security_t)cache->security,
+                             cache->channel);
+  if (status == NSAPI_ERROR_UNSUPPORTED) {
+    // The interface cannot pin the channel
+    status = wifi->connect(WIFI_SSID, WIFI_PASSWORD,
+                           (nsapi_security_t)cache->security);
+  }
+  if (status != NSAPI_ERROR_OK && static_ip) {
+    wifi->set_dhcp(true);
+  }
+  return status == NSAPI_ERROR_OK ? 0 : -1;
+}
+
 int connect_to_wifi(WiFiInterface *wifi) {
-  WiFiAccessPoint *ap;
+  Timer timer;
+  timer.start();
+
+  wifi_cache_t cache;
+  if (load_wifi_cache(&cache) == 0) {
+    printf("> Connecting to %02x:%02x:%02x:%02x:%02x:%02x on channel %u...\n",
+           cache.bssid[0], cache.bssid[1], cache.bssid[2], cache.bssid[3],
+           cache.bssid[4], cache.bssid[5], cache.channel);
+    if (connect_cached(wifi, &cache) == 0) {
+      if (!lease_valid(&cache)) {
+        // Record the address DHCP just leased
+        save_wifi_cache(wifi, cache.bssid, cache.channel,
+                        (nsapi_security_t)cache.security);
+      }
+      SocketAddress address;
+      wifi->get_ip_address(&address);
+      printf("> Connected to %s in %lld ms (cached)! IP: %s\n", WIFI_SSID,
+             duration_cast<milliseconds>(timer.elapsed_time()).count(),
+             address.get_ip_address());
+      return 0;
+    }
+    printf("> Cached network failed, scanning\n");
+  }
+
+  if (timer.elapsed_time() >
+      milliseconds(MBED_CONF_APP_WIFI_CONNECT_BUDGET_MS)) {
+    printf("WiFi connect budget spent - can't continue further.\n");
+    return -1;
+  }
+
   printf("> Scanning WiFi networks...\n");
-  int network_count = wifi->scan(NULL, 0);
+  WiFiAccessPoint networks[WIFI_SCAN_MAX_NETWORKS];
+  int network_count = wifi->scan(networks, WIFI_SCAN_MAX_NETWORKS);
   if (network_count <= 0) {
     printf("No WiFi hotspots found - can't continue further.\n");
     return -1;
   }
 
-  int status = wifi->connect(WIFI_SSID, WIFI_PASSWORD, NSAPI_SECURITY_WPA_WPA2);
+  // Join the strongest access point of the network
+  WiFiAccessPoint *ap = NULL;
+  for (int i = 0; i < network_count && i < WIFI_SCAN_MAX_NETWORKS; i++) {
+    if (strcmp(networks[i].get_ssid(), WIFI_SSID) == 0 &&
+        (!ap || networks[i].get_rssi() > ap->get_rssi())) {
+      ap = &networks[i];
+    }
+  }
+  if (!ap) {
+    printf("Network %s not found - can't continue further.\n", WIFI_SSID);
+    return -1;
+  }
+
+  wifi->set_dhcp(true);
+  int status = wifi->connect(WIFI_SSID, WIFI_PASSWORD, ap->get_security());
   if (status != 0) {
     printf("Connection error\n");
     return -1;
@@ -26,6 +175,14 @@ int connect_to_wifi(WiFiInterface *wifi) {
 
   SocketAddress address;
   wifi->get_ip_address(&address);
-  printf("> Connected to %s! IP: %s\n", WIFI_SSID, address.get_ip_address());
+  printf("> Connected to %s in %lld ms (scanned)! IP: %s\n", WIFI_SSID,
+         duration_cast<milliseconds>(timer.elapsed_time()).count(),
+         address.get_ip_address());
+  save_wifi_cache(wifi, ap->get_bssid(), ap->get_channel(), ap->get_security());
   return 0;
 }
+
+void disconnect_from_wifi(WiFiInterface *wifi) {
+  wifi->disconnect();
+  wifi->set_dhcp(true);
+}
@@ -10,15 +10,51 @@
 #ifndef WIFI_SERVICE_H
 #define WIFI_SERVICE_H
 
+#include "datastore.hpp"
 #include "mbed.h"
 #include "wifi_credentials.hpp"
 
+#define WIFI_CACHE_MAGIC 0x49464957 // "WIFI"
+#define WIFI_SCAN_MAX_NETWORKS 16
+
 /**
- * @brief Connect to the WiFi network specified in 'mbed_app.json'.
+ * @brief The network joined last, as it is stored in flash.
+ */
+typedef struct {
+  uint32_t magic;
+  char ssid[33]; // The cache is dropped when the credentials change
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t security;
+  char ip[NSAPI_IPv4_SIZE];
+  char netmask[NSAPI_IPv4_SIZE];
+  char gateway[NSAPI_IPv4_SIZE];
+  uint32_t saved; // Unix time the address was leased
+  uint32_t crc;
+} wifi_cache_t;
+
+/**
+ * @brief Connect to the WiFi network in 'wifi_credentials.hpp'.
+ *
+ * The network joined last is tried first, on its cached channel and with its
+ * cached address while the lease is likely to be valid, without scanning.
+ * Otherwise the networks are scanned for the channel and security of the
+ * network, which is cached once connected. The scan is skipped once
+ * wifi-connect-budget-ms has passed. The budget does not bound the connect
+ * calls themselves, which block until the driver gives up.
  *
  * @param wifi A WiFiInterface instance.
  * @return 0 upon success, -1 on error / failure.
  */
 int connect_to_wifi(WiFiInterface *wifi);
 
+/**
+ * @brief Disconnect from WiFi and go back to DHCP, so a cached address is
+ * never used past its lease.
+ *
+ * @param wifi A WiFiInterface instance.
+ * @return Void.
+ */
+void disconnect_from_wifi(WiFiInterface *wifi);
+
 #endif // WIFI_SERVICE_H